@@ -97,9 +97,8 @@ void print_matrix_stdout(double **matrix, int N) {
 }
 
 // ---------------------------
-// Thread Pool: Off-Diagonal Work per Column
-// For each column j, we spawn a new thread pool (multiple threads) to compute
-// the off-diagonal entries in that column.
+// Off-Diagonal Work per Column
+// Computes the off-diagonal entries of column j for one member's share of the rows.
 // ---------------------------
 void *offdiag_worker(void *arg) {
     thread_data_t *data = (thread_data_t *)arg;
@@ -116,53 +115,65 @@ void *offdiag_worker(void *arg) {
 }
 
 // ---------------------------
-// cholesky_parallel_multiple:
-// Implements the parallel-serial-parallel structure with a new thread pool for each column's
-// off-diagonal updates. Logs thread activity to threads_fp.
+// cholesky_phase:
+// The whole decomposition runs as a single team phase. For each column, member 0 computes the
+// diagonal element while the others wait at a barrier, then every member updates its share of
+// the off-diagonals and they meet at a second barrier before the next column.
 // ---------------------------
-void cholesky_parallel_multiple() {
+void cholesky_phase(tholder_team_t *team, size_t member, void *ctx) {
+    (void)ctx;
+    int t = (int)member;
+    int num_threads = (int)tholder_team_size(team);
+
     for (int j = 0; j < N; j++) {
         // SERIAL PORTION: Compute diagonal element L[j][j]
-        fprintf(threads_fp, "Main thread: [Serial] Computing diagonal for column %d...\n", j);
-        double sum = 0.0;
-        for (int k = 0; k < j; k++) {
-            sum += L[j][k] * L[j][k];
+        if (t == 0) {
+            fprintf(threads_fp, "Main thread: [Serial] Computing diagonal for column %d...\n", j);
+            double sum = 0.0;
+            for (int k = 0; k < j; k++) {
+                sum += L[j][k] * L[j][k];
+            }
+            L[j][j] = sqrt(A[j][j] - sum);
+            fprintf(threads_fp, "Main thread: [Serial] Computed L[%d][%d] = %f\n", j, j, L[j][j]);
         }
-        L[j][j] = sqrt(A[j][j] - sum);
-        fprintf(threads_fp, "Main thread: [Serial] Computed L[%d][%d] = %f\n", j, j, L[j][j]);
+        tholder_team_barrier(team);
 
         // If no off-diagonals exist, move to next column.
         if (j + 1 >= N)
             continue;
 
-        // PARALLEL PORTION: Spawn a new thread pool for this column.
-        fprintf(threads_fp, "Main thread: [Parallel] Spawning thread pool for column %d off-diagonals...\n", j);
+        // PARALLEL PORTION: Partition rows among the team members.
         int total_rows = N - (j + 1);
-        int num_threads = NUM_THREADS;
-        tholder_t *threads = (tholder_t *)malloc(num_threads * sizeof(tholder_t));
-        thread_data_t *tdata = (thread_data_t *)malloc(num_threads * sizeof(thread_data_t));
-
-        // Partition rows among threads.
         int base = total_rows / num_threads;
         int rem  = total_rows % num_threads;
-        for (int t = 0; t < num_threads; t++) {
-            tdata[t].j = j;
-            tdata[t].start = (j + 1) + t * base + (t < rem ? t : rem);
-            tdata[t].end = tdata[t].start + base + (t < rem ? 1 : 0);
-            fprintf(threads_fp, "   Main thread: Thread %d will process rows [%d, %d) for column %d.\n",
-                    t, tdata[t].start, tdata[t].end, j);
-            tholder_create(&threads[t], NULL, offdiag_worker, &tdata[t]);
-        }
-
-        // Wait for all threads in this pool to complete.
-        for (int t = 0; t < num_threads; t++) {
-            tholder_join(threads[t], NULL);
-        }
-        fprintf(threads_fp, "Main thread: [Parallel] Completed off-diagonal updates for column %d.\n", j);
+        thread_data_t tdata;
+        tdata.j = j;
+        tdata.start = (j + 1) + t * base + (t < rem ? t : rem);
+        tdata.end = tdata.start + base + (t < rem ? 1 : 0);
+        offdiag_worker(&tdata);
+
+        // Every row of column j must be done before the next diagonal reads it.
+        tholder_team_barrier(team);
+        if (t == 0)
+            fprintf(threads_fp, "Main thread: [Parallel] Completed off-diagonal updates for column %d.\n", j);
+    }
+}
 
-        free(threads);
-        free(tdata);
+// ---------------------------
+// cholesky_parallel_multiple:
+// Implements the parallel-serial-parallel structure with one persistent team of NUM_THREADS
+// threads for all columns, instead of a new set of tasks per column. Logs thread activity to threads_fp.
+// ---------------------------
+void cholesky_parallel_multiple() {
+    tholder_team_t *team = tholder_team_create(NUM_THREADS);
+    if (team == NULL) {
+        fprintf(stderr, "Error: could not start a team of %d threads.\n", NUM_THREADS);
+        exit(EXIT_FAILURE);
     }
+
+    tholder_team_run(team, cholesky_phase, NULL);
+
+    tholder_team_destroy(team);
 }
 
 // ---------------------------
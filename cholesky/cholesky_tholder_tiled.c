@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../tholder/tholder.h"
+#include <time.h>
+#include <sys/stat.h>   // For mkdir, stat
+#include <sys/types.h>  // For mode_t
+
+#define SEED 42
+#define DEFAULT_TILE_SIZE 64
+
+// ---------------------------
+// Global Variables for Matrices
+// ---------------------------
+static double **A = NULL;  // Input matrix (N x N)
+static double **L = NULL;  // Output lower-triangular matrix (N x N), factored in place
+static int N = 0;          // Matrix size
+static int NUM_THREADS = 0; // Number of threads to use
+static int TILE = 0;       // Tile size
+static int NUM_TILES = 0;  // Tiles per row/column
+
+// One data handle per lower tile, tile (i, j) is tiles[i * NUM_TILES + j]
+static tholder_handle_t *tiles = NULL;
+
+// ---------------------------
+// Structure for Tile Kernels
+// ---------------------------
+typedef struct {
+    int i;       // Tile row
+    int j;       // Tile column
+    int k;       // Step of the factorization
+} tile_task_t;
+
+// ---------------------------
+// Global File Pointers for Logging
+// ---------------------------
+FILE *result_fp = NULL;   // For results output
+
+// ---------------------------
+// Matrix Helper Functions
+// ---------------------------
+double **allocate_matrix(int N) {
+    double **matrix = (double **)malloc(N * sizeof(double *));
+    for (int i = 0; i < N; i++) {
+        matrix[i] = (double *)malloc(N * sizeof(double));
+    }
+    return matrix;
+}
+
+void free_matrix(double **matrix, int N) {
+    for (int i = 0; i < N; i++) {
+        free(matrix[i]);
+    }
+    free(matrix);
+}
+
+void generate_positive_definite_matrix(double **A, int N) {
+    srand(SEED);
+    // Fill with random values in [1,10]
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            A[i][j] = rand() % 10 + 1;
+        }
+    }
+    // Form A = A * A^T
+    double **temp = allocate_matrix(N);
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < N; k++) {
+                sum += A[i][k] * A[j][k];
+            }
+            temp[i][j] = sum;
+        }
+    }
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            A[i][j] = temp[i][j];
+        }
+    }
+    free_matrix(temp, N);
+}
+
+void print_matrix(double **matrix, int N, FILE *fp) {
+    int limit = (N < 5) ? N : 5;
+    for (int i = 0; i < limit; i++) {
+        for (int j = 0; j < limit; j++) {
+            fprintf(fp, "%8.4f ", matrix[i][j]);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+void print_matrix_stdout(double **matrix, int N) {
+    int limit = (N < 5) ? N : 5;
+    for (int i = 0; i < limit; i++) {
+        for (int j = 0; j < limit; j++) {
+            printf("%8.4f ", matrix[i][j]);
+        }
+        printf("\n");
+    }
+}
+
+// First and one-past-last row/column of tile t
+static int tile_begin(int t) {
+    return t * TILE;
+}
+
+static int tile_end(int t) {
+    return (t + 1) * TILE < N ? (t + 1) * TILE : N;
+}
+
+static tholder_handle_t *tile(int i, int j) {
+    return &tiles[i * NUM_TILES + j];
+}
+
+// ---------------------------
+// Tile Kernels
+// All four work on L in place. Every update from steps before k has already been subtracted
+// from the tiles of step k, so each kernel only sums over the columns of tile k.
+// ---------------------------
+
+// POTRF: factors diagonal tile (k, k).
+void *potrf_task(void *arg) {
+    tile_task_t *t = (tile_task_t *)arg;
+    int k0 = tile_begin(t->k), k1 = tile_end(t->k);
+    for (int j = k0; j < k1; j++) {
+        double sum = 0.0;
+        for (int p = k0; p < j; p++) {
+            sum += L[j][p] * L[j][p];
+        }
+        L[j][j] = sqrt(L[j][j] - sum);
+        for (int i = j + 1; i < k1; i++) {
+            double s = 0.0;
+            for (int p = k0; p < j; p++) {
+                s += L[i][p] * L[j][p];
+            }
+            L[i][j] = (L[i][j] - s) / L[j][j];
+        }
+    }
+    return NULL;
+}
+
+// TRSM: solves tile (i, k) against the factored diagonal tile (k, k).
+void *trsm_task(void *arg) {
+    tile_task_t *t = (tile_task_t *)arg;
+    int k0 = tile_begin(t->k), k1 = tile_end(t->k);
+    for (int r = tile_begin(t->i); r < tile_end(t->i); r++) {
+        for (int j = k0; j < k1; j++) {
+            double sum = 0.0;
+            for (int p = k0; p < j; p++) {
+                sum += L[r][p] * L[j][p];
+            }
+            L[r][j] = (L[r][j] - sum) / L[j][j];
+        }
+    }
+    return NULL;
+}
+
+// SYRK: subtracts tile (i, k) times its transpose from the lower half of diagonal tile (i, i).
+void *syrk_task(void *arg) {
+    tile_task_t *t = (tile_task_t *)arg;
+    int k0 = tile_begin(t->k), k1 = tile_end(t->k);
+    int i0 = tile_begin(t->i);
+    for (int r = i0; r < tile_end(t->i); r++) {
+        for (int c = i0; c <= r; c++) {
+            double sum = 0.0;
+            for (int p = k0; p < k1; p++) {
+                sum += L[r][p] * L[c][p];
+            }
+            L[r][c] -= sum;
+        }
+    }
+    return NULL;
+}
+
+// GEMM: subtracts tile (i, k) times the transpose of tile (j, k) from tile (i, j).
+void *gemm_task(void *arg) {
+    tile_task_t *t = (tile_task_t *)arg;
+    int k0 = tile_begin(t->k), k1 = tile_end(t->k);
+    for (int r = tile_begin(t->i); r < tile_end(t->i); r++) {
+        for (int c = tile_begin(t->j); c < tile_end(t->j); c++) {
+            double sum = 0.0;
+            for (int p = k0; p < k1; p++) {
+                sum += L[r][p] * L[c][p];
+            }
+            L[r][c] -= sum;
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------
+// cholesky_tiled:
+// Submits the right-looking tiled algorithm in its serial order and lets the DAG scheduler work out
+// which kernels can overlap. Unlike the column-by-column versions there is no barrier per step:
+// the GEMMs of step k keep running while POTRF and TRSM of step k + 1 start on tiles they are done with.
+// ---------------------------
+void cholesky_tiled() {
+    // Count the kernels first so their arguments fit in one allocation
+    int num_tasks = 0;
+    for (int k = 0; k < NUM_TILES; k++) {
+        int below = NUM_TILES - k - 1;
+        num_tasks += 1 + 2 * below + below * (below - 1) / 2;
+    }
+    tile_task_t *args = (tile_task_t *)malloc(num_tasks * sizeof(tile_task_t));
+    int next = 0;
+
+    tholder_dag_t *dag = tholder_dag_create();
+
+    for (int k = 0; k < NUM_TILES; k++) {
+        tile_task_t *potrf = &args[next++];
+        *potrf = (tile_task_t){k, k, k};
+        tholder_dep_t potrf_deps[] = {{tile(k, k), THOLDER_WRITE}};
+        tholder_dag_submit(dag, potrf_task, potrf, potrf_deps, 1);
+
+        for (int i = k + 1; i < NUM_TILES; i++) {
+            tile_task_t *trsm = &args[next++];
+            *trsm = (tile_task_t){i, k, k};
+            tholder_dep_t trsm_deps[] = {{tile(k, k), THOLDER_READ}, {tile(i, k), THOLDER_WRITE}};
+            tholder_dag_submit(dag, trsm_task, trsm, trsm_deps, 2);
+        }
+
+        for (int i = k + 1; i < NUM_TILES; i++) {
+            tile_task_t *syrk = &args[next++];
+            *syrk = (tile_task_t){i, i, k};
+            tholder_dep_t syrk_deps[] = {{tile(i, k), THOLDER_READ}, {tile(i, i), THOLDER_WRITE}};
+            tholder_dag_submit(dag, syrk_task, syrk, syrk_deps, 2);
+
+            for (int j = k + 1; j < i; j++) {
+                tile_task_t *gemm = &args[next++];
+                *gemm = (tile_task_t){i, j, k};
+                tholder_dep_t gemm_deps[] = {
+                    {tile(i, k), THOLDER_READ}, {tile(j, k), THOLDER_READ}, {tile(i, j), THOLDER_WRITE}};
+                tholder_dag_submit(dag, gemm_task, gemm, gemm_deps, 3);
+            }
+        }
+    }
+
+    tholder_dag_destroy(dag);
+    free(args);
+}
+
+// ---------------------------
+// main:
+// Usage: ./cholesky_tholder_tiled <matrix_size> <num_threads> [<tile_size>] [<test_number>]
+// tile_size defaults to DEFAULT_TILE_SIZE and test_number to 1.
+// This program writes the results to [matrix_size]_[test_number]_tiled.txt in directory
+// "tholder_tests/<matrix_size>/".
+// ---------------------------
+int main(int argc, char *argv[]) {
+    if (argc < 3 || argc > 5) {
+        fprintf(stderr, "Usage: %s <matrix_size> <num_threads> [<tile_size>] [<test_number>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    N = atoi(argv[1]);
+    NUM_THREADS = atoi(argv[2]);
+    TILE = argc >= 4 ? atoi(argv[3]) : DEFAULT_TILE_SIZE;
+    if (N <= 0 || NUM_THREADS <= 0 || TILE <= 0) {
+        fprintf(stderr, "Error: matrix_size, num_threads and tile_size must be positive.\n");
+        return EXIT_FAILURE;
+    }
+
+    int test_number = 1;
+    if (argc == 5) {
+        test_number = atoi(argv[4]);
+    }
+
+    // Allocate matrices A and L.
+    A = allocate_matrix(N);
+    L = allocate_matrix(N);
+
+    // Generate random positive-definite matrix.
+    generate_positive_definite_matrix(A, N);
+
+    // The factorization overwrites the lower triangle of A, so start L from it.
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            L[i][j] = j <= i ? A[i][j] : 0.0;
+        }
+    }
+
+    NUM_TILES = (N + TILE - 1) / TILE;
+    tiles = (tholder_handle_t *)malloc(NUM_TILES * NUM_TILES * sizeof(tholder_handle_t));
+    for (int t = 0; t < NUM_TILES * NUM_TILES; t++) {
+        tiles[t] = (tholder_handle_t)THOLDER_HANDLE_INIT;
+    }
+
+    // The waiting main thread runs kernels too, so at most NUM_THREADS run at once.
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.max_active_workers = NUM_THREADS > 1 ? NUM_THREADS - 1 : 1;
+    tholder_init_opts(&opts);
+
+    printf("\nInitial Matrix A (top-left 5x5):\n");
+    print_matrix(A, N, stdout);
+
+    // -----------------------------
+    // Prepare directory structure:
+    // Create "tholder_tests" if it doesn't exist,
+    // and a subdirectory named with the matrix size.
+    // -----------------------------
+    struct stat st = {0};
+    if (stat("tholder_tests", &st) == -1) {
+        #ifdef _WIN32
+            mkdir("tholder_tests");
+        #else
+            mkdir("tholder_tests", 0700);
+        #endif
+    }
+    char subdir[256];
+    snprintf(subdir, sizeof(subdir), "tholder_tests/%d", N);
+    if (stat(subdir, &st) == -1) {
+        #ifdef _WIN32
+            mkdir(subdir);
+        #else
+            mkdir(subdir, 0700);
+        #endif
+    }
+
+    char result_filename[256];
+    snprintf(result_filename, sizeof(result_filename), "%s/%d_%d_tiled.txt", subdir, N, test_number);
+
+    // Time the Cholesky decomposition.
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    cholesky_tiled();
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double elapsed_time = (end_time.tv_sec - start_time.tv_sec) +
+                          (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+
+    printf("\nCholesky Decomposition (L Matrix, top-left 5x5):\n");
+    print_matrix(L, N, stdout);
+    printf("\nExecution Time: %.6f seconds\n", elapsed_time);
+
+    // Open results file and write results.
+    result_fp = fopen(result_filename, "w");
+    if (result_fp == NULL) {
+        perror("Error opening result file for writing");
+        return EXIT_FAILURE;
+    }
+    fprintf(result_fp, "Matrix Size: %d\nTile Size: %d\nTest Number: %d\n\n", N, TILE, test_number);
+    fprintf(result_fp, "Initial Matrix A (top-left 5x5):\n");
+    print_matrix(A, N, result_fp);
+    fprintf(result_fp, "\nCholesky Decomposition (L Matrix, top-left 5x5):\n");
+    print_matrix(L, N, result_fp);
+    fprintf(result_fp, "\nExecution Time: %.6f seconds\n", elapsed_time);
+    fclose(result_fp);
+    printf("\nResults written to %s\n", result_filename);
+
+    // Free resources.
+    tholder_destroy();
+    for (int t = 0; t < NUM_TILES * NUM_TILES; t++) {
+        tholder_handle_destroy(&tiles[t]);
+    }
+    free(tiles);
+    free_matrix(A, N);
+    free_matrix(L, N);
+
+    return EXIT_SUCCESS;
+}
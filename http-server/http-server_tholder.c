@@ -17,6 +17,9 @@ int server_fd;
 
 atomic_int req_number = ATOMIC_VAR_INIT(0);
 
+// Requests get a pool of their own, so batch work in the default pool cannot delay them
+tholder_pool_t *handler_pool;
+
 void close_server_fd()
 { 
     printf("\n");
@@ -34,7 +37,7 @@ void *handle_request(void *args)
     int client_fd = (int)args;
     char buffer[BUFFER_SIZE];
 
-    // Read request
+    // Read request. The reactor only queued us once the client had sent something, so this does not block
     ssize_t bytes_received = read(client_fd, buffer, BUFFER_SIZE - 1);
     if (bytes_received < 0) {
         perror("read");
@@ -62,12 +65,27 @@ void *handle_request(void *args)
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        printf("Usage: %s [PORT]\n", argv[0]);
+        printf("Usage: %s [PORT] [MAX_WORKERS]\n", argv[0]);
         exit(1);
     }
     int port;
     sscanf(argv[1], "%d", &port);
 
+    // Handlers never wait for a slow client, so one worker per core is enough by default.
+    // Under overload, new connections wait in the listen backlog instead of each getting a thread:
+    // once every worker is busy and the queue is full, the reactor blocks on submission.
+    // Idle handlers stay parked instead of exiting, so a request never waits for a thread to start
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.max_workers = argc > 2 ? (size_t)atoi(argv[2]) : (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    opts.saturation_policy = THOLDER_SATURATION_BLOCK;
+    opts.keep_alive_ms = THOLDER_KEEP_ALIVE_FOREVER;
+    handler_pool = tholder_pool_create(&opts);
+    if (handler_pool == NULL) {
+        perror("tholder_pool_create");
+        exit(EXIT_FAILURE);
+    }
+
     int client_fd;
     socklen_t client_addr_len = sizeof(client_addr);
 
@@ -92,7 +110,7 @@ int main(int argc, char *argv[]) {
     signal(SIGINT, close_server_fd);
 
     // Listen for connections
-    if (listen(server_fd, 5) < 0) {
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen");
         close(server_fd);
         exit(EXIT_FAILURE);
@@ -106,8 +124,13 @@ int main(int argc, char *argv[]) {
             perror("accept");
             continue;
         }
-        tholder_t *tid = (tholder_t *)malloc(sizeof(tholder_t));
-        tholder_create(tid, NULL, handle_request, (void *)client_fd);
+        // Nobody joins a request, so it needs no handle. It waits for the request on a reactor thread
+        // of the pool instead of on a worker. Failures come back as an errno value, errno is left alone
+        int ret = tholder_pool_submit_on_readable(handler_pool, client_fd, handle_request, (void *)client_fd);
+        if (ret != 0) {
+            fprintf(stderr, "tholder_pool_submit_on_readable: %s\n", strerror(ret));
+            close(client_fd);
+        }
     }
     printf("\n");
 
@@ -17,6 +17,16 @@ for ((i = 0; i < $3; i++)); do
         echo Expected $2, got $num_tasks
         printf "%s\n" "$ret"
         exit 2
+    elif ! printf "%s\n" "$ret" | egrep -q "Steady-state allocations: 0\$"; then
+        printf "\rTRIAL $i FAILED  \n"
+        echo Task submission allocated after the first loop
+        printf "%s\n" "$ret" | egrep "Steady-state allocations"
+        exit 3
+    elif [[ $(printf "%s\n" "$ret" | sed -n "s/^Churn allocations: //p") -gt 8 ]] then
+        printf "\rTRIAL $i FAILED  \n"
+        echo Task submission allocated after workers came and went
+        printf "%s\n" "$ret" | egrep "Churn allocations"
+        exit 4
     else
         printf "\rTRIAL $i SUCCESS"
     fi
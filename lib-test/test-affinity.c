@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+#include "sched.h"
+#include "pthread.h"
+
+#include "../tholder/tholder.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define NUM_TASKS 200
+
+// The CPUs the process may run on when the test starts
+cpu_set_t allowed;
+// Tasks the main thread runs while it helps in a join are not placed at all
+pthread_t main_thread;
+
+// Returns 1 if the worker running it is not placed the way `args` (a tholder_affinity) asks for
+void *check_placement(void *args)
+{
+    tholder_affinity affinity = (tholder_affinity)(size_t)args;
+    if (pthread_equal(pthread_self(), main_thread))
+        return NULL;
+
+    cpu_set_t set;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        return (void *)1;
+
+    // Only the CPUs we were allowed to begin with
+    cpu_set_t outside;
+    CPU_XOR(&outside, &set, &allowed);
+    CPU_AND(&outside, &outside, &set);
+    if (CPU_COUNT(&outside) != 0)
+        return (void *)1;
+
+    if (tholder_current_node() < 0)
+        return (void *)1;
+
+    // Every policy but NUMA pins a worker to one CPU
+    if (affinity != THOLDER_AFFINITY_NUMA && CPU_COUNT(&set) != 1)
+        return (void *)1;
+    return NULL;
+}
+
+void *current_node(void *args)
+{
+    (void)args;
+    return (void *)(size_t)(tholder_current_node() + 1);
+}
+
+int check_policy(tholder_affinity affinity, const char *name, const int *cpu_list, size_t cpu_list_size)
+{
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.affinity = affinity;
+    opts.cpu_list = cpu_list;
+    opts.cpu_list_size = cpu_list_size;
+    tholder_init_opts(&opts);
+
+    int failures = 0;
+    tholder_t handles[NUM_TASKS];
+    for (size_t i = 0; i < NUM_TASKS; i++)
+        tholder_create(&handles[i], NULL, check_placement, (void *)(size_t)affinity);
+    for (size_t i = 0; i < NUM_TASKS; i++)
+    {
+        void *ret;
+        tholder_join(handles[i], &ret);
+        if (ret != NULL)
+            failures++;
+    }
+
+    // Tasks hinted at the node of their data run on it, or on the joining thread
+    static double data[4096];
+    data[0] = 1.0;
+    int node = tholder_node_of(data);
+    if (node < 0)
+        node = 0;
+    for (size_t i = 0; i < NUM_TASKS; i++)
+        tholder_create_on_node(&handles[i], NULL, current_node, NULL, node);
+    for (size_t i = 0; i < NUM_TASKS; i++)
+    {
+        void *ret;
+        tholder_join(handles[i], &ret);
+        int ran_on = (int)(size_t)ret - 1;
+        if (ran_on != node && ran_on != -1)
+            failures++;
+    }
+
+    tholder_destroy();
+    if (failures != 0)
+        printf("%s: %d tasks were misplaced\n", name, failures);
+    return failures;
+}
+
+int main()
+{
+    main_thread = pthread_self();
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return 1;
+
+    int first_cpu = 0;
+    while (!CPU_ISSET(first_cpu, &allowed))
+        first_cpu++;
+
+    int failures = 0;
+    failures += check_policy(THOLDER_AFFINITY_COMPACT, "compact", NULL, 0);
+    failures += check_policy(THOLDER_AFFINITY_SCATTER, "scatter", NULL, 0);
+    failures += check_policy(THOLDER_AFFINITY_LIST, "list", &first_cpu, 1);
+    failures += check_policy(THOLDER_AFFINITY_NUMA, "numa", NULL, 0);
+
+    printf("affinity: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,184 @@
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdatomic.h"
+#include "errno.h"
+
+#define QUEUED 100
+#define TREE_DEPTH 16
+#define TREE_NODES ((1 << (TREE_DEPTH + 1)) - 1)
+#define LOOP_SIZE 1000
+
+tholder_cancel_t token = THOLDER_CANCEL_INIT;
+atomic_bool release;
+atomic_int ran;
+atomic_int wrong_token;
+
+// Keeps the only worker busy until released, so everything else waits in the queue
+void *blocker(void *args)
+{
+    while (!atomic_load(&release))
+        usleep(100);
+    return args;
+}
+
+void *count(void *args)
+{
+    atomic_fetch_add(&ran, 1);
+    return args;
+}
+
+// Children created without a token inherit this task's, so cancelling it stops the whole tree
+void *tree_node(void *args)
+{
+    intptr_t depth = (intptr_t)args;
+    if (tholder_cancel_requested())
+        return NULL;
+    if (tholder_current_cancel() != &token)
+        atomic_fetch_add(&wrong_token, 1);
+    atomic_fetch_add(&ran, 1);
+    if (depth == 0)
+        return NULL;
+
+    tholder_t left, right;
+    tholder_create(&left, NULL, tree_node, (void *)(depth - 1));
+    tholder_create(&right, NULL, tree_node, (void *)(depth - 1));
+    tholder_join(left, NULL);
+    tholder_join(right, NULL);
+    return NULL;
+}
+
+// Started before the token is cancelled, so it runs and has to notice on its own
+void *poll_until_cancelled(void *args)
+{
+    while (!tholder_cancel_requested())
+        usleep(100);
+    return args;
+}
+
+void count_range(size_t begin, size_t end, void *ctx)
+{
+    (void)ctx;
+    atomic_fetch_add(&ran, (int)(end - begin));
+}
+
+// Cancels its own token, then runs a static loop whose lanes inherit it and are dropped before they start
+void *cancelled_loop(void *args)
+{
+    tholder_cancel(&token);
+    return (void *)(intptr_t)tholder_parallel_for(0, LOOP_SIZE, 1, THOLDER_STATIC, count_range, args);
+}
+
+int main()
+{
+    int failures = 0;
+
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.max_workers = 1;
+    opts.parallelism = 4;
+    tholder_init_opts(&opts);
+
+    // Queued tasks are dropped once the token is cancelled, and their joins return THOLDER_CANCELLED
+    tholder_t block, handles[QUEUED];
+    tholder_create(&block, NULL, blocker, NULL);
+    for (int i = 0; i < QUEUED; i++)
+        tholder_create_cancellable(&handles[i], NULL, count, NULL, &token);
+    tholder_cancel(&token);
+    atomic_store(&release, true);
+    int cancelled_joins = 0;
+    for (int i = 0; i < QUEUED; i++)
+    {
+        void *result;
+        tholder_join(handles[i], &result);
+        cancelled_joins += result == THOLDER_CANCELLED;
+    }
+    tholder_join(block, NULL);
+    tholder_stats_t stats;
+    tholder_stats(&stats);
+    if (atomic_load(&ran) != 0 || cancelled_joins != QUEUED || stats.tasks_cancelled != QUEUED)
+    {
+        printf("cancel: %d of %d queued tasks ran, %d joins returned THOLDER_CANCELLED, %llu counted as cancelled\n",
+               atomic_load(&ran), QUEUED, cancelled_joins, stats.tasks_cancelled);
+        failures++;
+    }
+
+    // Same for a group whose token is cancelled while its tasks wait
+    tholder_cancel_init(&token, NULL);
+    atomic_store(&release, false);
+    tholder_create(&block, NULL, blocker, NULL);
+    tholder_group_t group = THOLDER_GROUP_INIT;
+    tholder_group_set_cancel(&group, &token);
+    for (int i = 0; i < QUEUED; i++)
+        tholder_group_spawn(&group, count, NULL);
+    tholder_cancel(&token);
+    atomic_store(&release, true);
+    tholder_group_wait(&group);
+    tholder_join(block, NULL);
+    if (atomic_load(&ran) != 0)
+    {
+        printf("cancel: %d tasks of a cancelled group ran\n", atomic_load(&ran));
+        failures++;
+    }
+
+    // A running tree stops early once its root's token is cancelled
+    tholder_cancel_init(&token, NULL);
+    tholder_t root;
+    tholder_create_cancellable(&root, NULL, tree_node, (void *)TREE_DEPTH, &token);
+    while (atomic_load(&ran) < 100)
+        usleep(100);
+    tholder_cancel(&token);
+    tholder_join(root, NULL);
+    if (atomic_load(&ran) >= TREE_NODES || atomic_load(&wrong_token) != 0)
+    {
+        printf("cancel: %d of %d tree nodes ran, %d without the root's token\n", atomic_load(&ran), TREE_NODES,
+               atomic_load(&wrong_token));
+        failures++;
+    }
+
+    // A task that already runs is not interrupted, it sees the flag when it polls. Cancelling a parent
+    // cancels its children, but not the other way around
+    tholder_cancel_t parent = THOLDER_CANCEL_INIT, child;
+    tholder_cancel_init(&child, &parent);
+    tholder_t poller;
+    tholder_create_cancellable(&poller, NULL, poll_until_cancelled, (void *)1, &child);
+    usleep(10000);
+    void *result;
+    tholder_cancel(&parent);
+    tholder_join(poller, &result);
+    tholder_cancel_t other_parent = THOLDER_CANCEL_INIT, other_child;
+    tholder_cancel_init(&other_child, &other_parent);
+    tholder_cancel(&other_child);
+    if (result != (void *)1 || !tholder_is_cancelled(&child) || tholder_is_cancelled(&other_parent) ||
+        tholder_current_cancel() != NULL)
+    {
+        printf("cancel: a running task or a token hierarchy behaved wrong\n");
+        failures++;
+    }
+
+    // A parallel_for whose lanes were dropped says so instead of returning 0
+    tholder_cancel_init(&token, NULL);
+    atomic_store(&ran, 0);
+    tholder_t loop;
+    tholder_create_cancellable(&loop, NULL, cancelled_loop, NULL, &token);
+    tholder_join(loop, &result);
+    if ((intptr_t)result != ECANCELED || atomic_load(&ran) >= LOOP_SIZE)
+    {
+        printf("cancel: parallel_for with dropped lanes returned %d after %d of %d iterations\n", (int)(intptr_t)result,
+               atomic_load(&ran), LOOP_SIZE);
+        failures++;
+    }
+    atomic_store(&ran, 0);
+    int loop_ret = tholder_parallel_for(0, LOOP_SIZE, 1, THOLDER_STATIC, count_range, NULL);
+    if (loop_ret != 0 || atomic_load(&ran) != LOOP_SIZE)
+    {
+        printf("cancel: parallel_for without a token returned %d after %d of %d iterations\n", loop_ret,
+               atomic_load(&ran), LOOP_SIZE);
+        failures++;
+    }
+
+    tholder_destroy();
+
+    printf("cancel: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,96 @@
+#include "stdint.h"
+
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define NUM_HANDLES 16
+#define NUM_TASKS 5000
+#define MAX_DEPS 4
+#define ROUNDS 3
+
+// One operation on the values behind the handles. Reads are summed into every write, so the result
+// only matches the serial one if every task saw exactly the writes that came before it
+typedef struct op
+{
+    size_t id;
+    size_t num_deps;
+    tholder_dep_t deps[MAX_DEPS];
+    size_t index[MAX_DEPS];
+} op;
+
+uint64_t values[NUM_HANDLES];
+uint64_t expected[NUM_HANDLES];
+tholder_handle_t handles[NUM_HANDLES];
+op ops[NUM_TASKS];
+
+void apply(op *o, uint64_t *v)
+{
+    uint64_t sum = o->id;
+    for (size_t d = 0; d < o->num_deps; d++)
+        sum += v[o->index[d]];
+    for (size_t d = 0; d < o->num_deps; d++)
+        if (o->deps[d].access == THOLDER_WRITE)
+            v[o->index[d]] = v[o->index[d]] * 31 + sum;
+}
+
+void *run_op(void *args)
+{
+    op *o = (op *)args;
+    // Now and then take long enough for later tasks to catch up
+    if (o->id % 97 == 0)
+        usleep(100);
+    apply(o, values);
+    return NULL;
+}
+
+int main()
+{
+    for (size_t h = 0; h < NUM_HANDLES; h++)
+        handles[h] = (tholder_handle_t)THOLDER_HANDLE_INIT;
+
+    srand(7);
+    int failures = 0;
+    tholder_dag_t *dag = tholder_dag_create();
+
+    // Handles are reused across waits, which must forget the finished tasks
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (size_t i = 0; i < NUM_TASKS; i++)
+        {
+            op *o = &ops[i];
+            o->id = round * NUM_TASKS + i;
+            o->num_deps = 1 + rand() % MAX_DEPS;
+            for (size_t d = 0; d < o->num_deps; d++)
+            {
+                // The same handle may show up twice in one task
+                o->index[d] = rand() % NUM_HANDLES;
+                o->deps[d].handle = &handles[o->index[d]];
+                o->deps[d].access = rand() % 3 == 0 ? THOLDER_WRITE : THOLDER_READ;
+            }
+            apply(o, expected);
+            tholder_dag_submit(dag, run_op, o, o->deps, o->num_deps);
+        }
+        tholder_dag_wait(dag);
+
+        for (size_t h = 0; h < NUM_HANDLES; h++)
+        {
+            if (values[h] != expected[h])
+            {
+                printf("dag: round %d handle %zu is %llu, expected %llu\n", round, h,
+                       (unsigned long long)values[h], (unsigned long long)expected[h]);
+                failures++;
+            }
+        }
+    }
+
+    tholder_dag_destroy(dag);
+    for (size_t h = 0; h < NUM_HANDLES; h++)
+        tholder_handle_destroy(&handles[h]);
+
+    printf("dag: %s\n", failures == 0 ? "PASSED" : "FAILED");
+
+    tholder_destroy();
+    return failures;
+}
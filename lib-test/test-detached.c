@@ -0,0 +1,49 @@
+#include "stdatomic.h"
+
+#include "../tholder/tholder.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define NUM_TASKS 10000
+
+atomic_int tasks = ATOMIC_VAR_INIT(0);
+
+void *count_task(void *args)
+{
+    (void)args;
+    atomic_fetch_add(&tasks, 1);
+    return NULL;
+}
+
+int main()
+{
+    tholder_init(DEFAULT_MAX_THREADS);
+    size_t allocations_before = atomic_load(&task_output_allocations);
+
+    int failures = 0;
+    for (int i = 0; i < NUM_TASKS; i++)
+    {
+        if (tholder_spawn_detached(count_task, NULL) != 0)
+            failures++;
+    }
+
+    // Detached tasks take nothing from the task_output slabs
+    size_t allocations = atomic_load(&task_output_allocations) - allocations_before;
+
+    // Workers drain the queue before tholder_destroy() returns
+    tholder_destroy();
+
+    if (atomic_load(&tasks) != NUM_TASKS)
+    {
+        printf("detached: %d of %d tasks ran\n", atomic_load(&tasks), NUM_TASKS);
+        failures++;
+    }
+    if (allocations != 0)
+    {
+        printf("detached: %zu task_output slabs allocated\n", allocations);
+        failures++;
+    }
+
+    printf("detached: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,87 @@
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdatomic.h"
+
+#define MAX_WORKERS 8
+#define PERIOD_MS 5
+#define BURST_TASKS 200
+#define SMALL_BURSTS 20
+#define SMALL_BURST_TASKS 16
+
+tholder_pool_t *pool;
+atomic_int finished;
+
+void *sleep_briefly(void *args)
+{
+    usleep(1000);
+    atomic_fetch_add(&finished, 1);
+    return args;
+}
+
+// Spawns detached tasks, so this thread does not help run them, and waits for them to finish
+void run_burst(int tasks)
+{
+    atomic_store(&finished, 0);
+    for (int i = 0; i < tasks; i++)
+        tholder_pool_spawn_detached(pool, sleep_briefly, NULL);
+    while (atomic_load(&finished) < tasks)
+        usleep(500);
+}
+
+int main()
+{
+    int failures = 0;
+
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.elastic = true;
+    opts.min_workers = 1;
+    opts.max_workers = MAX_WORKERS;
+    opts.elastic_period_ms = PERIOD_MS;
+    pool = tholder_pool_create(&opts);
+
+    // A long burst of tasks that keep every worker busy makes the controller grow the pool
+    run_burst(BURST_TASKS);
+    tholder_stats_t stats;
+    tholder_pool_stats(pool, &stats);
+    if (stats.elastic_grows == 0 || stats.target_workers <= 1 || stats.target_workers > MAX_WORKERS)
+    {
+        printf("elastic: target is %zu after %llu grows under load\n", stats.target_workers, stats.elastic_grows);
+        failures++;
+    }
+
+    // Short bursts with pauses shorter than it takes to shrink keep the workers alive, so they do not
+    // cost a pthread_create each
+    size_t spawned_before = stats.threads_spawned;
+    for (int i = 0; i < SMALL_BURSTS; i++)
+    {
+        run_burst(SMALL_BURST_TASKS);
+        usleep(2000);
+    }
+    tholder_pool_stats(pool, &stats);
+    if (stats.threads_spawned - spawned_before > MAX_WORKERS)
+    {
+        printf("elastic: %zu workers spawned for %d short bursts\n", stats.threads_spawned - spawned_before,
+               SMALL_BURSTS);
+        failures++;
+    }
+
+    // Once idle, the pool shrinks back to `min_workers`
+    for (int i = 0; i < 200 && (stats.target_workers > 1 || stats.live_workers > 1); i++)
+    {
+        usleep(10000);
+        tholder_pool_stats(pool, &stats);
+    }
+    if (stats.elastic_shrinks == 0 || stats.target_workers != 1 || stats.live_workers != 1)
+    {
+        printf("elastic: %zu live workers and a target of %zu after %llu shrinks while idle\n", stats.live_workers,
+               stats.target_workers, stats.elastic_shrinks);
+        failures++;
+    }
+
+    tholder_pool_destroy(pool);
+
+    printf("elastic: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,119 @@
+#include "stdint.h"
+
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdatomic.h"
+
+#define FIB_N 18
+#define YIELD_LIMIT 1000000
+
+atomic_bool finished;
+uintptr_t fib_result;
+
+// Every call but the leaves spawns both halves and joins them
+void *fib(void *args)
+{
+    uintptr_t n = (uintptr_t)args;
+    if (n < 2)
+        return (void *)n;
+
+    tholder_t a, b;
+    void *x, *y;
+    tholder_create(&a, NULL, fib, (void *)(n - 1));
+    tholder_create(&b, NULL, fib, (void *)(n - 2));
+    tholder_join(a, &x);
+    tholder_join(b, &y);
+    return (void *)((uintptr_t)x + (uintptr_t)y);
+}
+
+uintptr_t fib_serial(uintptr_t n)
+{
+    return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+void *run_fib(void *args)
+{
+    fib_result = (uintptr_t)fib(args);
+    atomic_store(&finished, true);
+    return NULL;
+}
+
+atomic_bool ponged;
+int ping_yields;
+
+void *pong(void *args)
+{
+    atomic_store(&ponged, true);
+    return args;
+}
+
+// With a single worker, pong() only gets to run if tholder_yield() lets go of it
+void *ping(void *args)
+{
+    tholder_spawn_detached(pong, NULL);
+    for (ping_yields = 0; ping_yields < YIELD_LIMIT && !atomic_load(&ponged); ping_yields++)
+        tholder_yield();
+    atomic_store(&finished, true);
+    return args;
+}
+
+// Runs `fn` as a detached task on `pool`, so this thread does not help, and waits for it to set `finished`
+void run_on(tholder_pool_t *pool, void *(*fn)(void *), void *arg)
+{
+    atomic_store(&finished, false);
+    tholder_pool_spawn_detached(pool, fn, arg);
+    while (!atomic_load(&finished))
+        usleep(1000);
+}
+
+int main()
+{
+    int failures = 0;
+
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.fibers = true;
+    opts.max_workers = 1;
+    opts.fiber_stack_size = 64 * 1024;
+    tholder_pool_t *pool = tholder_pool_create(&opts);
+
+    // Each join suspends its task, so the single worker keeps many fibers alive at once
+    run_on(pool, run_fib, (void *)FIB_N);
+    tholder_stats_t stats;
+    tholder_pool_stats(pool, &stats);
+    if (fib_result != fib_serial(FIB_N))
+    {
+        printf("fibers: fib(%d) = %lu, expected %lu\n", FIB_N, (unsigned long)fib_result,
+               (unsigned long)fib_serial(FIB_N));
+        failures++;
+    }
+    if (stats.threads_spawned != 1 || stats.fibers <= 1 || stats.fibers > opts.max_fibers)
+    {
+        printf("fibers: %zu workers and %zu fibers for fib(%d)\n", stats.threads_spawned, stats.fibers, FIB_N);
+        failures++;
+    }
+
+    run_on(pool, ping, NULL);
+    if (!atomic_load(&ponged))
+    {
+        printf("fibers: pong never ran after %d yields\n", ping_yields);
+        failures++;
+    }
+    tholder_pool_destroy(pool);
+
+    // With only a few fibers, the other tasks run on the worker's stack and join the usual way
+    opts.max_fibers = 4;
+    pool = tholder_pool_create(&opts);
+    run_on(pool, run_fib, (void *)FIB_N);
+    tholder_pool_stats(pool, &stats);
+    if (fib_result != fib_serial(FIB_N) || stats.fibers > 4)
+    {
+        printf("fibers: fib(%d) = %lu with %zu of 4 fibers\n", FIB_N, (unsigned long)fib_result, stats.fibers);
+        failures++;
+    }
+    tholder_pool_destroy(pool);
+
+    printf("fibers: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,99 @@
+#include "stdint.h"
+
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define NUM_FUTURES 100
+#define CHAIN_LENGTH 1000
+
+tholder_future_t *futures[NUM_FUTURES];
+
+void *identity(void *args)
+{
+    return args;
+}
+
+void *sleep_then_return(void *args)
+{
+    usleep(1000 * (useconds_t)(uintptr_t)args);
+    return args;
+}
+
+// Continuation of when_all: every input is done, so reading them does not block
+void *sum_values(void *value, void *ctx)
+{
+    (void)value;
+    (void)ctx;
+    uintptr_t sum = 0;
+    for (int i = 0; i < NUM_FUTURES; i++)
+    {
+        if (!tholder_future_ready(futures[i]))
+            return (void *)UINTPTR_MAX;
+        sum += (uintptr_t)tholder_future_get(futures[i]);
+    }
+    return (void *)sum;
+}
+
+void *increment(void *value, void *ctx)
+{
+    (void)ctx;
+    return (void *)((uintptr_t)value + 1);
+}
+
+int main()
+{
+    int failures = 0;
+
+    // when_all followed by a continuation
+    for (int i = 0; i < NUM_FUTURES; i++)
+        futures[i] = tholder_async(identity, (void *)(uintptr_t)i);
+    tholder_future_t *all = tholder_when_all(futures, NUM_FUTURES);
+    tholder_future_t *sum = tholder_then(all, sum_values, NULL);
+    uintptr_t expected = NUM_FUTURES * (NUM_FUTURES - 1) / 2;
+    if ((uintptr_t)tholder_future_get(sum) != expected)
+    {
+        printf("future: when_all sum %lu, expected %lu\n", (unsigned long)(uintptr_t)tholder_future_get(sum), (unsigned long)expected);
+        failures++;
+    }
+    tholder_future_release(sum);
+    tholder_future_release(all);
+    for (int i = 0; i < NUM_FUTURES; i++)
+        tholder_future_release(futures[i]);
+
+    // A long chain of continuations, built before the first link has finished
+    tholder_future_t *link = tholder_async(identity, (void *)0);
+    for (int i = 0; i < CHAIN_LENGTH; i++)
+    {
+        tholder_future_t *next = tholder_then(link, increment, NULL);
+        tholder_future_release(link);
+        link = next;
+    }
+    if ((uintptr_t)tholder_future_get(link) != CHAIN_LENGTH)
+    {
+        printf("future: chain ended at %lu, expected %d\n", (unsigned long)(uintptr_t)tholder_future_get(link), CHAIN_LENGTH);
+        failures++;
+    }
+    tholder_future_release(link);
+
+    // when_any completes with the value of the fastest input
+    tholder_future_t *racers[3];
+    racers[0] = tholder_async(sleep_then_return, (void *)200);
+    racers[1] = tholder_async(sleep_then_return, (void *)1);
+    racers[2] = tholder_async(sleep_then_return, (void *)300);
+    tholder_future_t *any = tholder_when_any(racers, 3);
+    if ((uintptr_t)tholder_future_get(any) != 1)
+    {
+        printf("future: when_any returned %lu, expected 1\n", (unsigned long)(uintptr_t)tholder_future_get(any));
+        failures++;
+    }
+    tholder_future_release(any);
+    for (int i = 0; i < 3; i++)
+        tholder_future_release(racers[i]);
+
+    tholder_destroy();
+
+    printf("future: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,74 @@
+#include "stdint.h"
+
+#include "../tholder/tholder.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define FIB_N 22
+#define FIB_CUTOFF 8
+#define MAX_ACTIVE 2
+
+size_t fib_serial(size_t n)
+{
+    return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+// Every level spawns a child and joins it, so without help-while-joining each level would park a worker
+void *fib_task(void *args)
+{
+    size_t n = (size_t)(uintptr_t)args;
+    if (n < FIB_CUTOFF)
+        return (void *)(uintptr_t)fib_serial(n);
+
+    tholder_t child;
+    void *left;
+    tholder_create(&child, NULL, fib_task, (void *)(uintptr_t)(n - 1));
+    size_t right = (size_t)(uintptr_t)fib_task((void *)(uintptr_t)(n - 2));
+    tholder_join(child, &left);
+
+    return (void *)(uintptr_t)((size_t)(uintptr_t)left + right);
+}
+
+// Runs the recursion under one scheduler and checks the result and how many workers it needed
+int check_scheduler(tholder_scheduler scheduler, const char *name)
+{
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.scheduler = scheduler;
+    opts.max_active_workers = MAX_ACTIVE;
+    opts.keep_alive_ms = THOLDER_KEEP_ALIVE_FOREVER;
+    tholder_init_opts(&opts);
+
+    size_t spawned_before = threads_spawned;
+    tholder_t root;
+    void *result;
+    tholder_create(&root, NULL, fib_task, (void *)(uintptr_t)FIB_N);
+    tholder_join(root, &result);
+    size_t spawned = threads_spawned - spawned_before;
+
+    tholder_destroy();
+
+    int failures = 0;
+    if ((size_t)(uintptr_t)result != fib_serial(FIB_N))
+    {
+        printf("%s: fib(%d) = %zu, expected %zu\n", name, FIB_N, (size_t)(uintptr_t)result, fib_serial(FIB_N));
+        failures++;
+    }
+    // Joins only sleep once there is nothing left to run, so the pool should stay far below one worker per level
+    if (spawned > 2 * FIB_N)
+    {
+        printf("%s: spawned %zu workers with max_active_workers %d\n", name, spawned, MAX_ACTIVE);
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    int failures = 0;
+    failures += check_scheduler(THOLDER_SCHED_FIFO, "fifo");
+    failures += check_scheduler(THOLDER_SCHED_STEALING, "stealing");
+
+    printf("nested joins: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
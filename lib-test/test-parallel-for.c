@@ -0,0 +1,93 @@
+#include "stdatomic.h"
+
+#include "../tholder/tholder.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "stdint.h"
+
+#define RANGE_SIZE 100003
+
+atomic_int visits[RANGE_SIZE];
+
+// Counts how many times each index was handed to a lane
+void visit_range(size_t begin, size_t end, void *ctx)
+{
+    (void)ctx;
+    for (size_t i = begin; i < end; i++)
+        atomic_fetch_add(&visits[i], 1);
+}
+
+// Runs one schedule over [begin, RANGE_SIZE) and checks that every index was visited exactly once
+int check_schedule(tholder_schedule schedule, const char *name, size_t begin, size_t grain)
+{
+    for (size_t i = 0; i < RANGE_SIZE; i++)
+        atomic_store(&visits[i], 0);
+
+    tholder_parallel_for(begin, RANGE_SIZE, grain, schedule, visit_range, NULL);
+
+    for (size_t i = 0; i < RANGE_SIZE; i++)
+    {
+        int expected = i < begin ? 0 : 1;
+        if (atomic_load(&visits[i]) != expected)
+        {
+            printf("%s (begin %zu, grain %zu): index %zu visited %d times\n", name, begin, grain, i, atomic_load(&visits[i]));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+atomic_size_t smallest_chunk;
+
+// Keeps the length of the smallest range handed to any lane
+void note_chunk(size_t begin, size_t end, void *ctx)
+{
+    (void)ctx;
+    size_t seen = atomic_load(&smallest_chunk);
+    while (end - begin < seen && !atomic_compare_exchange_weak(&smallest_chunk, &seen, end - begin))
+        ;
+}
+
+// Static blocks are never smaller than `grain`, even when the range does not divide into whole grains
+int check_static_grain(size_t size, size_t grain)
+{
+    atomic_store(&smallest_chunk, SIZE_MAX);
+    tholder_parallel_for(0, size, grain, THOLDER_STATIC, note_chunk, NULL);
+
+    size_t smallest = atomic_load(&smallest_chunk);
+    if (smallest < grain && smallest != size)
+    {
+        printf("static (size %zu, grain %zu): got a block of %zu iterations\n", size, grain, smallest);
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.parallelism = 8;
+    tholder_init_opts(&opts);
+
+    size_t grains[] = {1, 7, 1000, RANGE_SIZE * 2};
+    int failures = 0;
+
+    for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); g++)
+    {
+        failures += check_schedule(THOLDER_STATIC, "static", 0, grains[g]);
+        failures += check_schedule(THOLDER_DYNAMIC, "dynamic", 0, grains[g]);
+        failures += check_schedule(THOLDER_GUIDED, "guided", 0, grains[g]);
+        failures += check_schedule(THOLDER_GUIDED, "guided", 12345, grains[g]);
+    }
+
+    failures += check_static_grain(10, 4);
+    failures += check_static_grain(3, 4);
+    failures += check_static_grain(63, 8);
+    failures += check_static_grain(RANGE_SIZE, 1000);
+
+    printf("parallel_for: %s\n", failures == 0 ? "PASSED" : "FAILED");
+
+    tholder_destroy();
+    return failures;
+}
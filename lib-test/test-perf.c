@@ -0,0 +1,81 @@
+#include "stdatomic.h"
+
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "string.h"
+
+#define NUM_TASKS 100
+
+atomic_int finished;
+
+// Not static, so `-rdynamic` exports it and the report can name it
+void *perf_probe(void *args)
+{
+    volatile unsigned long sum = 0;
+    for (unsigned long i = 0; i < 10000; i++)
+        sum += i;
+    atomic_fetch_add(&finished, 1);
+    return args;
+}
+
+int main()
+{
+    int failures = 0;
+
+    // The report goes to stderr when the pool is destroyed, so catch it in a file
+    FILE *report = tmpfile();
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    dup2(fileno(report), STDERR_FILENO);
+
+    tholder_t handles[NUM_TASKS];
+    for (int i = 0; i < NUM_TASKS; i++)
+        tholder_create(&handles[i], NULL, perf_probe, NULL);
+    // Let the workers run them, tasks the main thread helps with while joining are not counted
+    for (int i = 0; i < 500 && atomic_load(&finished) < NUM_TASKS; i++)
+        usleep(1000);
+    for (int i = 0; i < NUM_TASKS; i++)
+        tholder_join(handles[i], NULL);
+    tholder_destroy();
+
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+
+    char line[512];
+    bool found = false;
+    rewind(report);
+    while (fgets(line, sizeof(line), report) != NULL)
+    {
+        char name[64];
+        unsigned long long tasks;
+        if (sscanf(line, "%63s %llu", name, &tasks) != 2)
+            continue;
+        if (strcmp(name, "perf_probe") != 0 || tasks == 0 || tasks > NUM_TASKS)
+        {
+            printf("perf: unexpected report line: %s", line);
+            failures++;
+        }
+        found = true;
+    }
+    fclose(report);
+
+#ifdef THOLDER_PERF
+    if (!found)
+    {
+        printf("perf: tholder_destroy() printed no line for perf_probe\n");
+        failures++;
+    }
+#else
+    // Without `make PERF=1` nothing is counted and nothing is printed
+    if (found)
+    {
+        printf("perf: a report was printed without PERF=1\n");
+        failures++;
+    }
+#endif
+
+    printf("perf: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,121 @@
+#include "stdint.h"
+
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define NUM_TASKS 200
+#define NESTED_TASKS 4
+
+tholder_pool_t *small_pool;
+tholder_pool_t *large_pool;
+
+void *sleep_briefly(void *args)
+{
+    usleep(100);
+    return args;
+}
+
+// Spawns through the global API from a worker of `large_pool`, which must stay in that pool
+void *spawn_nested(void *args)
+{
+    tholder_t handles[NESTED_TASKS];
+    for (int i = 0; i < NESTED_TASKS; i++)
+        tholder_create(&handles[i], NULL, sleep_briefly, NULL);
+    for (int i = 0; i < NESTED_TASKS; i++)
+        tholder_join(handles[i], NULL);
+    return args;
+}
+
+// Runs on `small_pool` and waits for a task of `large_pool`
+void *join_other_pool(void *args)
+{
+    tholder_t handle;
+    void *ret = NULL;
+    if (tholder_pool_submit(large_pool, &handle, NULL, sleep_briefly, args) != 0)
+        return NULL;
+    tholder_join(handle, &ret);
+    return ret;
+}
+
+unsigned long long total_tasks(tholder_pool_t *pool)
+{
+    tholder_stats_t stats;
+    tholder_pool_stats(pool, &stats);
+    return stats.tasks_run + stats.tasks_run_outside;
+}
+
+int main()
+{
+    int failures = 0;
+
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.max_workers = 2;
+    opts.keep_alive_ms = THOLDER_KEEP_ALIVE_FOREVER;
+    small_pool = tholder_pool_create(&opts);
+    large_pool = tholder_pool_create(NULL);
+
+    tholder_t small[NUM_TASKS];
+    tholder_t large[NUM_TASKS];
+    for (uintptr_t i = 0; i < NUM_TASKS; i++)
+    {
+        tholder_pool_submit(small_pool, &small[i], NULL, join_other_pool, (void *)i);
+        tholder_pool_submit(large_pool, &large[i], NULL, spawn_nested, (void *)i);
+    }
+    for (uintptr_t i = 0; i < NUM_TASKS; i++)
+    {
+        void *ret;
+        tholder_join(small[i], &ret);
+        if ((uintptr_t)ret != i)
+        {
+            printf("pools: cross-pool join returned %lu, expected %lu\n", (unsigned long)(uintptr_t)ret, (unsigned long)i);
+            failures++;
+        }
+        tholder_join(large[i], NULL);
+    }
+
+    // Every task is counted by the pool it was submitted to, nested ones included
+    if (total_tasks(small_pool) != NUM_TASKS)
+    {
+        printf("pools: small pool ran %llu tasks, expected %d\n", total_tasks(small_pool), NUM_TASKS);
+        failures++;
+    }
+    if (total_tasks(large_pool) != NUM_TASKS * (2 + NESTED_TASKS))
+    {
+        printf("pools: large pool ran %llu tasks, expected %d\n", total_tasks(large_pool), NUM_TASKS * (2 + NESTED_TASKS));
+        failures++;
+    }
+
+    tholder_stats_t stats;
+    tholder_pool_stats(small_pool, &stats);
+    if (stats.threads_spawned > 2)
+    {
+        printf("pools: small pool spawned %zu workers, limit is 2\n", stats.threads_spawned);
+        failures++;
+    }
+
+    // The default pool is still separate, and stays usable after another pool is gone
+    tholder_pool_destroy(large_pool);
+    tholder_t handle;
+    void *ret = NULL;
+    tholder_create(&handle, NULL, sleep_briefly, (void *)7);
+    tholder_join(handle, &ret);
+    tholder_stats(&stats);
+    if ((uintptr_t)ret != 7 || stats.tasks_run + stats.tasks_run_outside != 1)
+    {
+        printf("pools: default pool ran %llu tasks, expected 1\n", stats.tasks_run + stats.tasks_run_outside);
+        failures++;
+    }
+    tholder_pool_submit(small_pool, &handle, NULL, sleep_briefly, (void *)8);
+    tholder_join(handle, &ret);
+    if ((uintptr_t)ret != 8)
+        failures++;
+
+    tholder_pool_destroy(small_pool);
+    tholder_destroy();
+
+    printf("pools: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include "stdint.h"
+
+#include "dlfcn.h"
+#include "pthread.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "string.h"
+#include "stdatomic.h"
+
+#include "../tholder/tholder.h"
+
+// A plain pthread program, meant to run as
+//     LD_PRELOAD=../tholder/lib/libtholder_preload.so ./target/test-preload
+// It only uses libtholder to check that it is interposed, through dlsym, so nothing of the static library is linked in
+
+#define NUM_THREADS 64
+#define NUM_WAITERS 16
+
+pthread_t seen_self[NUM_THREADS];
+atomic_int detached_done;
+
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t signal_cond = PTHREAD_COND_INITIALIZER;
+int signalled = 0;
+
+void stop_early(uintptr_t i)
+{
+    pthread_exit((void *)(i * 2));
+}
+
+void *record_self(void *args)
+{
+    uintptr_t i = (uintptr_t)args;
+    seen_self[i] = pthread_self();
+
+    // Half of the threads leave through pthread_exit() from a nested call
+    if (i % 2 == 0)
+        stop_early(i);
+    return (void *)(i * 2);
+}
+
+// Each thread appends the names of the cleanup handlers it ran, in the order they ran
+#define NUM_CLEANUPS 8
+char cleanup_order[NUM_CLEANUPS][4];
+
+void cleanup_a(void *args)
+{
+    strcat((char *)args, "a");
+}
+
+void cleanup_b(void *args)
+{
+    strcat((char *)args, "b");
+}
+
+void cleanup_c(void *args)
+{
+    strcat((char *)args, "c");
+}
+
+// Runs b through pthread_cleanup_pop(), then leaves through pthread_exit() with a and c still pushed
+void *run_cleanups(void *args)
+{
+    uintptr_t i = (uintptr_t)args;
+    char *order = cleanup_order[i];
+    pthread_cleanup_push(cleanup_a, order);
+    pthread_cleanup_push(cleanup_b, order);
+    pthread_cleanup_pop(1);
+    pthread_cleanup_push(cleanup_c, order);
+    stop_early(i);
+    pthread_cleanup_pop(0);
+    pthread_cleanup_pop(0);
+    return NULL;
+}
+
+void *count_detached(void *args)
+{
+    atomic_fetch_add(&detached_done, 1);
+    return args;
+}
+
+void *wait_for_signal(void *args)
+{
+    pthread_mutex_lock(&lock);
+    while (!signalled)
+        pthread_cond_wait(&signal_cond, &lock);
+    pthread_mutex_unlock(&lock);
+    return args;
+}
+
+void *trivial(void *args)
+{
+    return args;
+}
+
+int main()
+{
+    int failures = 0;
+
+    void (*stats_fn)(tholder_stats_t *);
+    *(void **)&stats_fn = dlsym(RTLD_DEFAULT, "tholder_stats");
+    if (stats_fn == NULL)
+    {
+        printf("preload: libtholder_preload.so is not loaded\n");
+        return 1;
+    }
+
+    // Threads waiting on a condition variable that is only signalled after joining another thread. A join that
+    // ran the waiters on this thread, or a pool that left the other thread queued behind them, never gets there.
+    // Done first, while no idle workers are around to empty the queue before the join looks at it. The alarm
+    // turns a hang into a failure
+    alarm(30);
+    pthread_t waiters[NUM_WAITERS];
+    for (uintptr_t i = 0; i < NUM_WAITERS; i++)
+        pthread_create(&waiters[i], NULL, wait_for_signal, (void *)i);
+    void *ret;
+    pthread_t quick;
+    pthread_create(&quick, NULL, trivial, (void *)7);
+    if (pthread_join(quick, &ret) != 0 || (uintptr_t)ret != 7)
+    {
+        printf("preload: thread joined next to blocked ones returned %p\n", ret);
+        failures++;
+    }
+    pthread_mutex_lock(&lock);
+    signalled = 1;
+    pthread_cond_broadcast(&signal_cond);
+    pthread_mutex_unlock(&lock);
+    for (uintptr_t i = 0; i < NUM_WAITERS; i++)
+    {
+        if (pthread_join(waiters[i], &ret) != 0 || (uintptr_t)ret != i)
+        {
+            printf("preload: waiting thread %lu returned %p\n", (unsigned long)i, ret);
+            failures++;
+        }
+    }
+    alarm(0);
+
+    pthread_t threads[NUM_THREADS];
+    for (uintptr_t i = 0; i < NUM_THREADS; i++)
+        pthread_create(&threads[i], NULL, record_self, (void *)i);
+    for (uintptr_t i = 0; i < NUM_THREADS; i++)
+    {
+        void *ret;
+        if (pthread_join(threads[i], &ret) != 0 || (uintptr_t)ret != i * 2)
+        {
+            printf("preload: thread %lu returned %p\n", (unsigned long)i, ret);
+            failures++;
+        }
+        // pthread_self() inside the thread matches what pthread_create() returned
+        if (!pthread_equal(seen_self[i], threads[i]))
+        {
+            printf("preload: pthread_self() of thread %lu differs from its handle\n", (unsigned long)i);
+            failures++;
+        }
+    }
+
+    // pthread_exit() runs the handlers still pushed, innermost first, and ends only the task
+    pthread_t cleaners[NUM_CLEANUPS];
+    for (uintptr_t i = 0; i < NUM_CLEANUPS; i++)
+        pthread_create(&cleaners[i], NULL, run_cleanups, (void *)i);
+    for (uintptr_t i = 0; i < NUM_CLEANUPS; i++)
+    {
+        if (pthread_join(cleaners[i], &ret) != 0 || (uintptr_t)ret != i * 2 || strcmp(cleanup_order[i], "bca") != 0)
+        {
+            printf("preload: thread %lu ran cleanup handlers \"%s\" and returned %p\n", (unsigned long)i,
+                   cleanup_order[i], ret);
+            failures++;
+        }
+    }
+
+    // Detached through the attribute and through pthread_detach()
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        pthread_t thread;
+        if (i % 2 == 0)
+            pthread_create(&thread, &attr, count_detached, NULL);
+        else
+        {
+            pthread_create(&thread, NULL, count_detached, NULL);
+            pthread_detach(thread);
+        }
+    }
+    pthread_attr_destroy(&attr);
+    while (atomic_load(&detached_done) < NUM_THREADS)
+        usleep(1000);
+
+    // A thread asking for a bigger stack than the workers have is a real thread, and still joins
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 << 20);
+    pthread_t big;
+    pthread_create(&big, &attr, record_self, (void *)1);
+    if (pthread_join(big, &ret) != 0 || (uintptr_t)ret != 2)
+    {
+        printf("preload: thread with its own stack returned %p\n", ret);
+        failures++;
+    }
+    pthread_attr_destroy(&attr);
+
+    // Every thread but the one with its own stack ran as a task
+    tholder_stats_t stats;
+    stats_fn(&stats);
+    unsigned long long expected = 2 * NUM_THREADS + NUM_WAITERS + NUM_CLEANUPS + 1;
+    if (stats.tasks_run + stats.tasks_run_outside != expected)
+    {
+        printf("preload: %llu tasks ran, expected %llu\n", stats.tasks_run + stats.tasks_run_outside, expected);
+        failures++;
+    }
+
+    printf("preload: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
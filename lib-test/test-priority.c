@@ -0,0 +1,91 @@
+#include "stdint.h"
+
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdatomic.h"
+
+#define TASKS_PER_LANE 40
+#define INTERVAL 4
+
+atomic_bool released;
+atomic_int started;
+atomic_int finished;
+tholder_priority order[3 * TASKS_PER_LANE];
+
+// Keeps the only worker busy until every task is queued
+void *hold_worker(void *args)
+{
+    while (!atomic_load(&released))
+        usleep(100);
+    return args;
+}
+
+void *record(void *args)
+{
+    order[atomic_fetch_add(&started, 1)] = (tholder_priority)(uintptr_t)args;
+    atomic_fetch_add(&finished, 1);
+    return NULL;
+}
+
+int main()
+{
+    int failures = 0;
+
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.max_workers = 1;
+    opts.keep_alive_ms = THOLDER_KEEP_ALIVE_FOREVER;
+    opts.background_interval = INTERVAL;
+    tholder_init_opts(&opts);
+
+    tholder_spawn_detached(hold_worker, NULL);
+    for (int i = 0; i < TASKS_PER_LANE; i++)
+    {
+        tholder_spawn_detached_priority(record, (void *)THOLDER_PRIORITY_BACKGROUND, THOLDER_PRIORITY_BACKGROUND);
+        tholder_spawn_detached_priority(record, (void *)THOLDER_PRIORITY_NORMAL, THOLDER_PRIORITY_NORMAL);
+        tholder_spawn_detached_priority(record, (void *)THOLDER_PRIORITY_HIGH, THOLDER_PRIORITY_HIGH);
+    }
+    atomic_store(&released, true);
+
+    // Not a join, so this thread does not help and the worker alone decides the order
+    while (atomic_load(&finished) < 3 * TASKS_PER_LANE)
+        usleep(1000);
+
+    int last_high = -1, first_normal = -1, last_normal = -1, background_before = 0;
+    for (int i = 0; i < 3 * TASKS_PER_LANE; i++)
+    {
+        if (order[i] == THOLDER_PRIORITY_HIGH)
+            last_high = i;
+        else if (order[i] == THOLDER_PRIORITY_NORMAL)
+        {
+            if (first_normal < 0)
+                first_normal = i;
+            last_normal = i;
+        }
+    }
+    for (int i = 0; i < last_normal; i++)
+        if (order[i] == THOLDER_PRIORITY_BACKGROUND)
+            background_before++;
+
+    // Every high task is taken before any normal one
+    if (last_high > first_normal)
+    {
+        printf("priority: high task at %d after normal task at %d\n", last_high, first_normal);
+        failures++;
+    }
+
+    // Background work gets about every INTERVAL-th turn while the other lanes are busy, not only the leftovers
+    int expected = 2 * TASKS_PER_LANE / INTERVAL - 2;
+    if (background_before < expected)
+    {
+        printf("priority: %d background tasks ran before the last normal one, expected at least %d\n",
+               background_before, expected);
+        failures++;
+    }
+
+    tholder_destroy();
+
+    printf("priority: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
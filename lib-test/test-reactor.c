@@ -0,0 +1,208 @@
+#include "../tholder/tholder.h"
+#include "errno.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdatomic.h"
+#include "time.h"
+#include "sys/socket.h"
+
+#define CONNECTIONS 200
+#define ROUNDS 3
+#define WORKERS 2
+// Ready fds that a queue of REJECT_CAPACITY slots has to turn away at first
+#define REJECTED_FDS 16
+#define REJECT_CAPACITY 4
+
+tholder_pool_t *pool;
+int fds[CONNECTIONS][2];
+int received[CONNECTIONS];
+atomic_int bad_reads;
+atomic_int closed;
+atomic_bool dropped_ran;
+atomic_bool release_worker;
+atomic_int rejected_ran;
+
+// Reads one byte per wake-up and waits for the next until it has seen every round
+void *on_readable(void *args)
+{
+    intptr_t conn = (intptr_t)args;
+    char byte;
+    if (read(fds[conn][0], &byte, 1) != 1 || byte != (char)(conn + received[conn]))
+        atomic_fetch_add(&bad_reads, 1);
+
+    if (++received[conn] < ROUNDS)
+    {
+        // The reactor already forgot the fd, so it can be registered again, from inside a task of the pool
+        if (tholder_submit_on_readable(fds[conn][0], on_readable, args) != 0)
+            atomic_fetch_add(&bad_reads, 1);
+        return NULL;
+    }
+    close(fds[conn][0]);
+    atomic_fetch_add(&closed, 1);
+    return NULL;
+}
+
+void *never_readable(void *args)
+{
+    atomic_store(&dropped_ran, true);
+    return args;
+}
+
+void *hold_worker(void *args)
+{
+    while (!atomic_load(&release_worker))
+        usleep(1000);
+    return args;
+}
+
+void *count_rejected(void *args)
+{
+    char byte;
+    if (read((int)(intptr_t)args, &byte, 1) == 1)
+        atomic_fetch_add(&rejected_ran, 1);
+    return NULL;
+}
+
+static double cpu_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int main()
+{
+    int failures = 0;
+
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.max_workers = WORKERS;
+    opts.reactor_threads = 2;
+    pool = tholder_pool_create(&opts);
+
+    for (intptr_t i = 0; i < CONNECTIONS; i++)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) != 0)
+        {
+            perror("socketpair");
+            return 1;
+        }
+        if (tholder_pool_submit_on_readable(pool, fds[i][0], on_readable, (void *)i) != 0)
+            failures++;
+    }
+
+    // Nothing is readable yet, so nothing runs and no worker is needed
+    usleep(20000);
+    tholder_stats_t stats;
+    tholder_pool_stats(pool, &stats);
+    if (stats.threads_spawned != 0 || stats.fd_dispatches != 0 || stats.fds_waiting != CONNECTIONS)
+    {
+        printf("reactor: %zu workers spawned and %llu tasks queued before any fd was readable, %zu waiting\n",
+               stats.threads_spawned, stats.fd_dispatches, stats.fds_waiting);
+        failures++;
+    }
+
+    // Every round at once, the second byte is already there when the first task registers again
+    for (int i = 0; i < CONNECTIONS; i++)
+        for (int round = 0; round < ROUNDS; round++)
+        {
+            char byte = (char)(i + round);
+            if (write(fds[i][1], &byte, 1) != 1)
+                failures++;
+        }
+
+    for (int i = 0; i < 500 && atomic_load(&closed) < CONNECTIONS; i++)
+        usleep(10000);
+
+    tholder_pool_stats(pool, &stats);
+    if (atomic_load(&closed) != CONNECTIONS || atomic_load(&bad_reads) != 0)
+    {
+        printf("reactor: %d of %d connections done, %d bad reads\n", atomic_load(&closed), CONNECTIONS,
+               atomic_load(&bad_reads));
+        failures++;
+    }
+    if (stats.fd_dispatches != CONNECTIONS * ROUNDS || stats.fds_waiting != 0 || stats.live_workers > WORKERS)
+    {
+        printf("reactor: %llu tasks queued, %zu still waiting, %zu live workers\n", stats.fd_dispatches,
+               stats.fds_waiting, stats.live_workers);
+        failures++;
+    }
+
+    // One task per fd at a time, and only fds epoll can watch
+    int pair[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+    if (tholder_pool_submit_on_readable(pool, pair[0], never_readable, NULL) != 0 ||
+        tholder_pool_submit_on_readable(pool, pair[0], never_readable, NULL) != EEXIST)
+    {
+        printf("reactor: registering an fd twice did not fail with EEXIST\n");
+        failures++;
+    }
+    FILE *file = tmpfile();
+    if (tholder_pool_submit_on_readable(pool, fileno(file), never_readable, NULL) != EPERM)
+    {
+        printf("reactor: registering a regular file did not fail with EPERM\n");
+        failures++;
+    }
+    fclose(file);
+
+    // The task still waiting on `pair[0]` is dropped with the pool
+    tholder_pool_destroy(pool);
+    if (atomic_load(&dropped_ran))
+    {
+        printf("reactor: a task ran without its fd becoming readable\n");
+        failures++;
+    }
+    close(pair[0]);
+    close(pair[1]);
+    for (int i = 0; i < CONNECTIONS; i++)
+        close(fds[i][1]);
+
+    // A full queue that rejects tasks must not make the reactor spin on fds that stay readable
+    tholder_default_options(&opts);
+    opts.max_workers = 1;
+    opts.queue_capacity = REJECT_CAPACITY;
+    opts.saturation_policy = THOLDER_SATURATION_REJECT;
+    opts.reactor_threads = 1;
+    pool = tholder_pool_create(&opts);
+    tholder_pool_spawn_detached(pool, hold_worker, NULL);
+
+    int rejected[REJECTED_FDS][2];
+    for (int i = 0; i < REJECTED_FDS; i++)
+    {
+        char byte = 0;
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, rejected[i]) != 0 || write(rejected[i][1], &byte, 1) != 1 ||
+            tholder_pool_submit_on_readable(pool, rejected[i][0], count_rejected, (void *)(intptr_t)rejected[i][0]) != 0)
+            failures++;
+    }
+
+    usleep(20000);
+    double cpu_before = cpu_ms();
+    usleep(100000);
+    double cpu_spent = cpu_ms() - cpu_before;
+    if (cpu_spent > 30)
+    {
+        printf("reactor: %.1f ms of CPU in 100 ms while the queue was full\n", cpu_spent);
+        failures++;
+    }
+
+    // Once the worker makes room, the rejected tasks are offered again and all of them run
+    atomic_store(&release_worker, true);
+    for (int i = 0; i < 500 && atomic_load(&rejected_ran) < REJECTED_FDS; i++)
+        usleep(10000);
+    tholder_pool_stats(pool, &stats);
+    if (atomic_load(&rejected_ran) != REJECTED_FDS || stats.fds_waiting != 0)
+    {
+        printf("reactor: %d of %d rejected tasks ran, %zu still waiting\n", atomic_load(&rejected_ran), REJECTED_FDS,
+               stats.fds_waiting);
+        failures++;
+    }
+    tholder_pool_destroy(pool);
+    for (int i = 0; i < REJECTED_FDS; i++)
+    {
+        close(rejected[i][0]);
+        close(rejected[i][1]);
+    }
+
+    printf("reactor: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,113 @@
+#include "errno.h"
+#include "stdatomic.h"
+
+#include "../tholder/tholder.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define MAX_WORKERS 2
+#define QUEUE_CAPACITY 4
+#define NUM_TASKS 200
+
+atomic_int running;
+atomic_int max_running;
+atomic_int completed;
+pthread_t main_thread;
+atomic_int ran_inline;
+
+// Sleeps briefly so the queue fills up, and records how many tasks ran at once on pool workers
+void *slow_task(void *args)
+{
+    (void)args;
+    bool on_main = pthread_equal(pthread_self(), main_thread);
+    if (on_main)
+        atomic_fetch_add(&ran_inline, 1);
+    else
+    {
+        int now = atomic_fetch_add(&running, 1) + 1;
+        int max = atomic_load(&max_running);
+        while (now > max && !atomic_compare_exchange_weak(&max_running, &max, now))
+            ;
+    }
+
+    usleep(200);
+
+    if (!on_main)
+        atomic_fetch_sub(&running, 1);
+    atomic_fetch_add(&completed, 1);
+    return NULL;
+}
+
+// Floods a small pool under one policy and checks the limits held
+int check_policy(tholder_saturation_policy policy, const char *name)
+{
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.max_workers = MAX_WORKERS;
+    opts.queue_capacity = QUEUE_CAPACITY;
+    opts.saturation_policy = policy;
+    tholder_init_opts(&opts);
+
+    atomic_store(&running, 0);
+    atomic_store(&max_running, 0);
+    atomic_store(&completed, 0);
+    atomic_store(&ran_inline, 0);
+    size_t spawned_before = threads_spawned;
+
+    tholder_t handles[NUM_TASKS];
+    int accepted = 0, rejected = 0, failures = 0;
+    for (int i = 0; i < NUM_TASKS; i++)
+    {
+        int ret = tholder_create(&handles[accepted], NULL, slow_task, NULL);
+        if (ret == 0)
+            accepted++;
+        else if (ret == EAGAIN)
+            rejected++;
+        else
+        {
+            printf("%s: unexpected error %d\n", name, ret);
+            failures++;
+        }
+    }
+    for (int i = 0; i < accepted; i++)
+        tholder_join(handles[i], NULL);
+
+    tholder_destroy();
+
+    if (atomic_load(&completed) != accepted)
+    {
+        printf("%s: %d tasks accepted but %d completed\n", name, accepted, atomic_load(&completed));
+        failures++;
+    }
+    if (atomic_load(&max_running) > MAX_WORKERS)
+    {
+        printf("%s: %d tasks ran on workers at once, limit is %d\n", name, atomic_load(&max_running), MAX_WORKERS);
+        failures++;
+    }
+    if (policy == THOLDER_SATURATION_REJECT ? rejected == 0 : rejected != 0)
+    {
+        printf("%s: %d tasks rejected\n", name, rejected);
+        failures++;
+    }
+    if (policy == THOLDER_SATURATION_INLINE && atomic_load(&ran_inline) == 0)
+    {
+        printf("%s: no task ran on the submitting thread\n", name);
+        failures++;
+    }
+    printf("%s: %d accepted, %d rejected, %d inline, %zu workers spawned\n", name, accepted, rejected,
+           atomic_load(&ran_inline), threads_spawned - spawned_before);
+    return failures;
+}
+
+int main()
+{
+    main_thread = pthread_self();
+
+    int failures = 0;
+    failures += check_policy(THOLDER_SATURATION_BLOCK, "block");
+    failures += check_policy(THOLDER_SATURATION_INLINE, "inline");
+    failures += check_policy(THOLDER_SATURATION_REJECT, "reject");
+
+    printf("saturation: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
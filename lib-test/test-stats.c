@@ -0,0 +1,57 @@
+#include "stdatomic.h"
+
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define NUM_TASKS 500
+
+void *busy_task(void *args)
+{
+    (void)args;
+    usleep(50);
+    return NULL;
+}
+
+int main()
+{
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.collect_stats = true;
+    opts.dump_stats = true;
+    tholder_init_opts(&opts);
+
+    tholder_t handles[NUM_TASKS];
+    for (int i = 0; i < NUM_TASKS; i++)
+        tholder_create(&handles[i], NULL, busy_task, NULL);
+    for (int i = 0; i < NUM_TASKS; i++)
+        tholder_join(handles[i], NULL);
+
+    tholder_stats_t stats;
+    tholder_stats(&stats);
+
+    int failures = 0;
+    // Every task ran exactly once, either on a worker or on this thread while it joined
+    if (stats.tasks_run + stats.tasks_run_outside != NUM_TASKS)
+    {
+        printf("stats: %llu tasks on workers + %llu outside, expected %d\n", stats.tasks_run, stats.tasks_run_outside, NUM_TASKS);
+        failures++;
+    }
+    // Each task sleeps for 50us, so workers must have been busy at least that long per task
+    if (stats.busy_ns < stats.tasks_run * 50000ULL)
+    {
+        printf("stats: %llu ns busy for %llu tasks\n", stats.busy_ns, stats.tasks_run);
+        failures++;
+    }
+    if (stats.workers == 0 || stats.workers > stats.threads_spawned)
+    {
+        printf("stats: %zu worker slots for %zu spawned threads\n", stats.workers, stats.threads_spawned);
+        failures++;
+    }
+
+    tholder_destroy();
+
+    printf("stats: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
@@ -0,0 +1,58 @@
+#include "stdatomic.h"
+
+#include "../tholder/tholder.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define MEMBERS 4
+#define PHASES 1000
+#define STEPS 10
+
+atomic_int step_count;
+int failures = 0;
+
+// Every member bumps a shared counter once per step. After each barrier the counter
+// must show that all members finished the step, and nobody started the next one yet
+void phase(tholder_team_t *team, size_t member, void *ctx)
+{
+    int base = *(int *)ctx;
+    for (int s = 1; s <= STEPS; s++)
+    {
+        atomic_fetch_add(&step_count, 1);
+        tholder_team_barrier(team);
+
+        int expected = base + s * MEMBERS;
+        if (member == 0 && atomic_load(&step_count) != expected)
+        {
+            printf("step %d: counter %d, expected %d\n", s, atomic_load(&step_count), expected);
+            failures++;
+        }
+        tholder_team_barrier(team);
+    }
+}
+
+int main()
+{
+    tholder_team_t *team = tholder_team_create(MEMBERS);
+    if (team == NULL)
+    {
+        printf("team: could not create\n");
+        return 1;
+    }
+
+    for (int p = 0; p < PHASES; p++)
+    {
+        int base = atomic_load(&step_count);
+        tholder_team_run(team, phase, &base);
+        if (atomic_load(&step_count) != base + STEPS * MEMBERS)
+        {
+            printf("phase %d returned before every member finished\n", p);
+            failures++;
+        }
+    }
+
+    tholder_team_destroy(team);
+
+    printf("team: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
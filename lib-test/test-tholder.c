@@ -6,7 +6,12 @@
 #include "stdlib.h"
 
 atomic_int tasks = ATOMIC_VAR_INIT(0);
-extern size_t threads_spawned;
+
+// Bursts of nested joins with pauses long enough for idle workers to exit in between
+#define CHURN_BURSTS 100
+#define CHURN_WARMUP 10
+#define CHURN_FANOUT 8
+#define CHURN_GAP_US 5000
 
 // This function just adds one to a global variable
 // to keep track of the number of tasks that were completed
@@ -16,6 +21,17 @@ void *exec_task(void *)
     return NULL; 
 }
 
+// Joins its children on a worker, so their task_outputs end up on that worker's free list
+void *churn_parent(void *args)
+{
+    tholder_t children[CHURN_FANOUT];
+    for (int i = 0; i < CHURN_FANOUT; i++)
+        tholder_create(&children[i], NULL, (void *(*)(void *))exec_task, NULL);
+    for (int i = 0; i < CHURN_FANOUT; i++)
+        tholder_join(children[i], NULL);
+    return args;
+}
+
 int main(int argc, char *argv[])
 {
     if (argc != 3)
@@ -32,6 +48,9 @@ int main(int argc, char *argv[])
 
     tholder_t threads[num_threads];
 
+    // Slabs allocated while warming up the free lists in the first loop
+    size_t warmup_allocations = 0;
+
     for (size_t i = 0; i < num_loops; i++)
     {
         atomic_store(&tasks, 0);
@@ -43,8 +62,31 @@ int main(int argc, char *argv[])
             tholder_join(threads[i], NULL);
         
         printf("Tasks completed: %d\n", atomic_load(&tasks));
+
+        if (i == 0)
+            warmup_allocations = atomic_load(&task_output_allocations);
+    }
+
+    // Every loop after the first should reuse the task_outputs of the previous one
+    printf("Steady-state allocations: %zu\n", atomic_load(&task_output_allocations) - warmup_allocations);
+
+    // Workers that retire between bursts hand their free lists back. A worker that finds the shared list empty
+    // while the others hold theirs still takes a new slab, so this stays at a few slabs however many bursts run
+    size_t churn_warmup = 0;
+    for (int burst = 0; burst < CHURN_BURSTS; burst++)
+    {
+        tholder_t parents[CHURN_FANOUT];
+        for (int i = 0; i < CHURN_FANOUT; i++)
+            tholder_create(&parents[i], NULL, churn_parent, NULL);
+        for (int i = 0; i < CHURN_FANOUT; i++)
+            tholder_join(parents[i], NULL);
+        usleep(CHURN_GAP_US);
+
+        if (burst == CHURN_WARMUP - 1)
+            churn_warmup = atomic_load(&task_output_allocations);
     }
+    printf("Churn allocations: %zu\n", atomic_load(&task_output_allocations) - churn_warmup);
 
     tholder_destroy();
-    return threads_spawned;
+    return atomic_load(&threads_spawned);
 }
@@ -0,0 +1,214 @@
+#include "../tholder/tholder.h"
+#include "unistd.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "stdatomic.h"
+#include "time.h"
+
+#define MS 1000000ULL
+#define ONE_SHOTS 100
+#define MAX_DELAY_MS 300
+#define PERIOD_MS 5
+// A periodic timer of STALL_PERIOD_MS whose thread is stuck on a full queue for STALL_MS
+#define STALL_PERIOD_MS 10
+#define STALL_MS 300
+#define STALL_RUNS 64
+// Queue slots of the pools whose only worker is kept busy, and timers due meanwhile
+#define REJECTED_TIMERS 16
+#define REJECT_CAPACITY 4
+
+tholder_pool_t *pool;
+unsigned long long start_ns;
+unsigned long long delays[ONE_SHOTS];
+atomic_int fired;
+atomic_int early;
+atomic_int ticks;
+atomic_bool cancelled_ran;
+unsigned long long stall_runs[STALL_RUNS];
+atomic_int num_stall_runs;
+atomic_bool release_worker;
+atomic_int rejected_ran;
+
+unsigned long long now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+void *one_shot(void *args)
+{
+    if (now() - start_ns < delays[(size_t)args])
+        atomic_fetch_add(&early, 1);
+    atomic_fetch_add(&fired, 1);
+    return NULL;
+}
+
+void *tick(void *args)
+{
+    atomic_fetch_add(&ticks, 1);
+    return args;
+}
+
+void *record_run(void *args)
+{
+    int run = atomic_fetch_add(&num_stall_runs, 1);
+    if (run < STALL_RUNS)
+        stall_runs[run] = now();
+    return args;
+}
+
+void *hold_worker(void *args)
+{
+    while (!atomic_load(&release_worker))
+        usleep(1000);
+    return args;
+}
+
+// Sleeps on the worker, rather than waiting for a flag, since the main thread may block on the full queue
+void *stall_worker(void *args)
+{
+    usleep(STALL_MS * 1000);
+    return args;
+}
+
+void *nothing(void *args)
+{
+    return args;
+}
+
+void *count_rejected(void *args)
+{
+    atomic_fetch_add(&rejected_ran, 1);
+    return args;
+}
+
+void *must_not_run(void *args)
+{
+    atomic_store(&cancelled_ran, true);
+    return args;
+}
+
+int main()
+{
+    int failures = 0;
+
+    pool = tholder_pool_create(NULL);
+
+    // Delays across the first two levels of the wheel, so some timers have to cascade before they fire
+    srand(0);
+    start_ns = now();
+    for (size_t i = 0; i < ONE_SHOTS; i++)
+    {
+        delays[i] = (unsigned long long)(rand() % MAX_DELAY_MS) * MS + (unsigned long long)(rand() % 1000);
+        if (tholder_pool_submit_after(pool, NULL, delays[i], one_shot, (void *)i) != 0)
+            failures++;
+    }
+
+    tholder_timer_t cancelled, fired_once, periodic;
+    tholder_pool_submit_after(pool, &cancelled, 50 * MS, must_not_run, NULL);
+    tholder_pool_submit_after(pool, &fired_once, 1 * MS, tick, NULL);
+    if (!tholder_timer_cancel(cancelled) || tholder_timer_cancel(cancelled))
+    {
+        printf("timer: cancelling an armed timer did not succeed exactly once\n");
+        failures++;
+    }
+
+    for (int i = 0; i < 200 && atomic_load(&fired) < ONE_SHOTS; i++)
+        usleep(10000);
+    if (atomic_load(&fired) != ONE_SHOTS || atomic_load(&early) != 0)
+    {
+        printf("timer: %d of %d timers fired, %d of them early\n", atomic_load(&fired), ONE_SHOTS, atomic_load(&early));
+        failures++;
+    }
+    // Its entry may hold another timer by now, the handle must not reach it
+    if (tholder_timer_cancel(fired_once))
+    {
+        printf("timer: cancelled a timer that already fired\n");
+        failures++;
+    }
+
+    // A periodic timer keeps firing until it is cancelled, and not after
+    atomic_store(&ticks, 0);
+    tholder_pool_submit_every(pool, &periodic, PERIOD_MS * MS, tick, NULL);
+    usleep(20 * PERIOD_MS * 1000);
+    if (!tholder_timer_cancel(periodic))
+        failures++;
+    usleep(5 * PERIOD_MS * 1000);
+    int ticks_at_cancel = atomic_load(&ticks);
+    usleep(5 * PERIOD_MS * 1000);
+    if (ticks_at_cancel < 5 || ticks_at_cancel > 21 || atomic_load(&ticks) != ticks_at_cancel)
+    {
+        printf("timer: %d runs in 20 periods, %d after cancelling\n", ticks_at_cancel, atomic_load(&ticks) - ticks_at_cancel);
+        failures++;
+    }
+
+    tholder_stats_t stats;
+    tholder_pool_stats(pool, &stats);
+    if (stats.timers_pending != 0 || stats.timers_fired != (unsigned long long)ONE_SHOTS + 1 + ticks_at_cancel)
+    {
+        printf("timer: %zu timers pending and %llu fired\n", stats.timers_pending, stats.timers_fired);
+        failures++;
+    }
+
+    // A timer far out does not hold up destroying the pool, it is dropped
+    tholder_pool_submit_after(pool, NULL, 3600 * 1000 * MS, must_not_run, NULL);
+    unsigned long long destroy_ns = now();
+    tholder_pool_destroy(pool);
+    if (atomic_load(&cancelled_ran) || now() - destroy_ns > 1000 * MS)
+    {
+        printf("timer: a cancelled or dropped timer ran, or destroying the pool waited for one\n");
+        failures++;
+    }
+
+    // The timer thread blocks on a full queue while the only worker is busy. Once it gets going again, a periodic
+    // timer goes on with its schedule instead of running every period it missed
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.max_workers = 1;
+    opts.queue_capacity = REJECT_CAPACITY;
+    pool = tholder_pool_create(&opts);
+    tholder_pool_submit_every(pool, &periodic, STALL_PERIOD_MS * MS, record_run, NULL);
+    usleep(5 * STALL_PERIOD_MS * 1000);
+    tholder_pool_spawn_detached(pool, stall_worker, NULL);
+    usleep(1000);
+    for (int i = 0; i < REJECT_CAPACITY; i++)
+        tholder_pool_spawn_detached(pool, nothing, NULL);
+    usleep(STALL_MS * 1000 + 5 * STALL_PERIOD_MS * 1000);
+    tholder_timer_cancel(periodic);
+    tholder_pool_destroy(pool);
+    // Runs already queued when the worker stalled come out back to back, at most a queue's worth. The periods
+    // the timer thread missed while it was blocked are dropped, or they would follow right after
+    int bunched = 0;
+    int runs = atomic_load(&num_stall_runs) < STALL_RUNS ? atomic_load(&num_stall_runs) : STALL_RUNS;
+    for (int i = 1; i < runs; i++)
+        if (stall_runs[i] - stall_runs[i - 1] < STALL_PERIOD_MS * MS / 4)
+            bunched++;
+    if (bunched > REJECT_CAPACITY + 1)
+    {
+        printf("timer: %d of %d runs came right after the previous one after a stall\n", bunched, runs);
+        failures++;
+    }
+
+    // Due tasks a full queue rejects are offered again until they fit, and only then count as fired
+    opts.saturation_policy = THOLDER_SATURATION_REJECT;
+    pool = tholder_pool_create(&opts);
+    tholder_pool_spawn_detached(pool, hold_worker, NULL);
+    for (int i = 0; i < REJECTED_TIMERS; i++)
+        tholder_pool_submit_after(pool, NULL, 1 * MS, count_rejected, NULL);
+    usleep(50000);
+    atomic_store(&release_worker, true);
+    for (int i = 0; i < 200 && atomic_load(&rejected_ran) < REJECTED_TIMERS; i++)
+        usleep(10000);
+    tholder_pool_stats(pool, &stats);
+    if (atomic_load(&rejected_ran) != REJECTED_TIMERS || stats.timers_fired != REJECTED_TIMERS)
+    {
+        printf("timer: %d of %d timers ran under a full queue, %llu counted as fired\n", atomic_load(&rejected_ran),
+               REJECTED_TIMERS, stats.timers_fired);
+        failures++;
+    }
+    tholder_pool_destroy(pool);
+
+    printf("timer: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
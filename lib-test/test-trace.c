@@ -0,0 +1,62 @@
+#include "string.h"
+
+#include "../tholder/tholder.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define NUM_TASKS 100
+#define TRACE_FILE "target/test-trace.json"
+
+void *empty_task(void *args)
+{
+    return args;
+}
+
+// Counts the occurrences of `needle` in the file at `path`
+int count_in_file(const char *path, const char *needle)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+
+    int count = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) != NULL)
+        if (strstr(line, needle) != NULL)
+            count++;
+    fclose(fp);
+    return count;
+}
+
+int main()
+{
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.trace_path = TRACE_FILE;
+    tholder_init_opts(&opts);
+
+    tholder_t handles[NUM_TASKS];
+    for (int i = 0; i < NUM_TASKS; i++)
+        tholder_create(&handles[i], NULL, empty_task, NULL);
+    for (int i = 0; i < NUM_TASKS; i++)
+        tholder_join(handles[i], NULL);
+
+    // The trace is written here
+    tholder_destroy();
+
+    // Every task has one submit, one arrow into its start, and one join
+    int failures = 0;
+    const char *events[] = {"\"name\":\"submit\"", "\"ph\":\"f\"", "\"name\":\"join\""};
+    for (size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++)
+    {
+        int count = count_in_file(TRACE_FILE, events[i]);
+        if (count != NUM_TASKS)
+        {
+            printf("trace: %d events with %s, expected %d\n", count, events[i], NUM_TASKS);
+            failures++;
+        }
+    }
+
+    printf("trace: %s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures;
+}
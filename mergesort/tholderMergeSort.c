@@ -161,7 +161,7 @@ int main(int argc, char *argv[])
     // Existing usage: at least <num_threads> and one size.
     if (argc < 3)
     {
-        fprintf(stderr, "Usage: %s <num_threads> [ -m <min_parallel_size> ] [ -s <thread_stack_size> ] <size1> [size2 ...]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <num_threads> [ -m <min_parallel_size> ] [ -s <thread_stack_size> ] [ -w ] [ -f ] <size1> [size2 ...]\n", argv[0]);
         exit(1);
     }
 
@@ -174,7 +174,13 @@ int main(int argc, char *argv[])
 
     global_max_depth = (int)ceil(log2(desired_threads));
 
-    // Parse optional flags: -m and -s before the list of sizes.
+    tholder_options opts;
+    tholder_default_options(&opts);
+    // Joins in merge_sort_depth() run queued halves instead of parking, so the pool never needs
+    // more than `desired_threads` busy workers
+    opts.max_active_workers = desired_threads;
+
+    // Parse optional flags: -m, -s, -w and -f before the list of sizes.
     int arg_index = 2;
     while (arg_index < argc && argv[arg_index][0] == '-')
     {
@@ -188,12 +194,28 @@ int main(int argc, char *argv[])
             global_thread_stack_size = atoi(argv[arg_index + 1]);
             arg_index += 2;
         }
+        else if (strcmp(argv[arg_index], "-w") == 0)
+        {
+            // Use the work-stealing scheduler
+            opts.scheduler = THOLDER_SCHED_STEALING;
+            arg_index++;
+        }
+        else if (strcmp(argv[arg_index], "-f") == 0)
+        {
+            // Run every task on a fiber, so joins suspend instead of nesting on the worker's stack
+            opts.fibers = true;
+            arg_index++;
+        }
         else
         {
             arg_index++;
         }
     }
     int num_sizes = argc - arg_index;
+    // Fibers get the stack tasks would otherwise run on
+    opts.fiber_stack_size = global_thread_stack_size;
+
+    tholder_init_opts(&opts);
 
     srand(0);
 
@@ -16,7 +16,7 @@ typedef struct
 } Thread; 
 
 //Thread information
-tholder_t *Threads;
+tholder_future_t **Threads;
 Thread *Threads_data;
 
 //Input information, including thread count, graph count, and threshold
@@ -49,7 +49,7 @@ double difftimespec_ns(const struct timespec after, const struct timespec before
 void create_threads(){
 	
 	// Allocate memory for threads
-	Threads = (tholder_t *)malloc(num_threads * sizeof(tholder_t));
+	Threads = (tholder_future_t **)malloc(num_threads * sizeof(tholder_future_t *));
 }
 
 void allocate_thread_data(){
@@ -96,18 +96,10 @@ void *pagerank_parallel(void *arg){
     return 0;
 }
 
-void pagerank(){
-  double error = 100000;
-  new_eigen = calloc(num_nodes, sizeof(double));
-  while(error > threshold){
-    for (int i = 0; i < num_threads; i++)
-    {
-        tholder_create(&Threads[i], NULL, &pagerank_parallel, (void*) &Threads_data[i]);
-    }
-    for (int i = 0; i < num_threads; i++)
-	{
-		tholder_join(Threads[i], NULL);
-	}
+//Runs on the pool as a continuation once every block of the iteration is done
+void *normalize(void *value, void *ctx){
+    (void)value;
+    double *error = (double *) ctx;
     //Find the norm in order to normalize the new eigenvector
     double norm = 0;
     for(int i = 0; i < num_nodes; i++){
@@ -121,7 +113,28 @@ void pagerank(){
       new_error += (new_eigen[i] - eigen[i])*(new_eigen[i] - eigen[i]);
       eigen[i] = new_eigen[i];
     }
-    error = sqrt(new_error);
+    *error = sqrt(new_error);
+    return NULL;
+}
+
+void pagerank(){
+  double error = 100000;
+  new_eigen = calloc(num_nodes, sizeof(double));
+  while(error > threshold){
+    for (int i = 0; i < num_threads; i++)
+    {
+        Threads[i] = tholder_async(&pagerank_parallel, (void*) &Threads_data[i]);
+    }
+    //Chain the normalization after the blocks instead of joining each of them here
+    tholder_future_t *all = tholder_when_all(Threads, num_threads);
+    tholder_future_t *step = tholder_then(all, &normalize, &error);
+    tholder_future_get(step);
+    tholder_future_release(step);
+    tholder_future_release(all);
+    for (int i = 0; i < num_threads; i++)
+	{
+		tholder_future_release(Threads[i]);
+	}
   }
   double total = 0;
   for(int i = 0; i < num_nodes; i++){
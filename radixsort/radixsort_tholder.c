@@ -140,8 +140,8 @@ int main(int argc, char *argv[]) {
   srandom(seed); // Pseudo-random generator
 
   tholder_init(50);
-  // Initialize empty thread array
-  tholder_t thread_array[num_threads];
+  // Every round of tasks is spawned into this group and waited on at once
+  tholder_group_t group = THOLDER_GROUP_INIT;
 
   // Allocate memory for thread argument (building histogram)
   struct hist_arg *hist_args = (struct hist_arg *)malloc(sizeof(struct hist_arg) * num_threads);
@@ -190,12 +190,10 @@ int main(int argc, char *argv[]) {
       int start_index = local_N * thr_id;
       struct hist_arg arg = {start_index, MIN(start_index + local_N, N), k, A, &hist[2 * thr_id]};
       hist_args[thr_id] = arg;
-      tholder_create(&thread_array[thr_id], NULL, build_local_hist, (void *)&hist_args[thr_id]);
+      tholder_group_spawn(&group, build_local_hist, (void *)&hist_args[thr_id]);
     }
 
-    for (int thr_id = 0; thr_id < num_threads; thr_id++) {
-      tholder_join(thread_array[thr_id], NULL);
-    }
+    tholder_group_wait(&group);
 
 #ifdef TIMER
     clock_gettime(CLOCK_MONOTONIC, &timer1_end);
@@ -221,12 +219,10 @@ int main(int argc, char *argv[]) {
       int start_index = local_N * thr_id;
       struct new_index_arg arg = {thr_id, start_index, MIN(start_index + local_N, N), k, total_0bits, A, hist, new_indexes};
       new_index_args[thr_id] = arg;
-      tholder_create(&thread_array[thr_id], NULL, compute_new_indexes, (void *)&new_index_args[thr_id]);
+      tholder_group_spawn(&group, compute_new_indexes, (void *)&new_index_args[thr_id]);
     }
 
-    for (int thr_id = 0; thr_id < num_threads; thr_id++) {
-      tholder_join(thread_array[thr_id], NULL);
-    }
+    tholder_group_wait(&group);
 
 #ifdef TIMER
     clock_gettime(CLOCK_MONOTONIC, &timer3_end);
@@ -240,12 +236,10 @@ int main(int argc, char *argv[]) {
       int start_index = local_N * thr_id;
       struct rewrite_arg arg = {start_index, MIN(start_index + local_N, N), A, new_A, new_indexes};
       rewrite_args[thr_id] = arg;
-      tholder_create(&thread_array[thr_id], NULL, rewrite_A, (void *)&rewrite_args[thr_id]);
+      tholder_group_spawn(&group, rewrite_A, (void *)&rewrite_args[thr_id]);
     }
 
-    for (int thr_id = 0; thr_id < num_threads; thr_id++) {
-      tholder_join(thread_array[thr_id], NULL);
-    }
+    tholder_group_wait(&group);
     // Re-route pointer A
     A = new_A;
     new_A = save_A;
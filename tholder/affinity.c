@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "affinity.h"
+#include "tholder_internal.h"
+
+// CPUs in the order workers are placed on them by the compact and scatter policies
+static int compact_order[CPU_SETSIZE];
+static int scatter_order[CPU_SETSIZE];
+static size_t num_placements = 0;
+
+// NUMA node of every CPU id, and the CPUs of every node we may run on
+static int cpu_node[CPU_SETSIZE];
+static cpu_set_t *node_cpus = NULL;
+static int num_nodes = 1;
+// Nodes that have CPUs we may use, which the NUMA policy takes turns between
+static int *usable_nodes = NULL;
+static size_t num_usable_nodes = 0;
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+
+// Backs `cpu_list` when it comes from THOLDER_AFFINITY
+static int env_cpu_list[CPU_SETSIZE];
+
+// Expands a list like "0-3,8,10-11" into `out` in the order given. Returns the number of CPUs
+static size_t parse_cpu_list(const char *s, int *out, size_t max)
+{
+    size_t count = 0;
+    while (*s != '\0' && count < max)
+    {
+        if (!isdigit((unsigned char)*s))
+        {
+            s++;
+            continue;
+        }
+
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        for (long cpu = first; cpu <= last && count < max; cpu++)
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                out[count++] = (int)cpu;
+        s = end;
+    }
+    return count;
+}
+
+// Reads a CPU list from sysfs. Returns 0 if the file does not exist
+static size_t read_cpu_list(const char *path, int *out, size_t max)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return 0;
+
+    char line[4096];
+    size_t count = 0;
+    if (fgets(line, sizeof(line), fp) != NULL)
+        count = parse_cpu_list(line, out, max);
+    fclose(fp);
+    return count;
+}
+
+// 0 for the first hyperthread of a core, 1 for the second and so on
+static int sibling_rank(int cpu)
+{
+    char path[128];
+    int siblings[CPU_SETSIZE];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    size_t count = read_cpu_list(path, siblings, CPU_SETSIZE);
+
+    int rank = 0;
+    for (size_t i = 0; i < count; i++)
+        if (siblings[i] < cpu)
+            rank++;
+    return rank;
+}
+
+static void read_topology()
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+
+    // Every CPU is on node 0 unless sysfs says otherwise
+    memset(cpu_node, 0, sizeof(cpu_node));
+    num_nodes = 1;
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir != NULL)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            int node;
+            if (sscanf(entry->d_name, "node%d", &node) != 1 || node < 0)
+                continue;
+
+            char path[128];
+            int cpus[CPU_SETSIZE];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            size_t count = read_cpu_list(path, cpus, CPU_SETSIZE);
+            for (size_t i = 0; i < count; i++)
+            {
+                cpu_node[cpus[i]] = node;
+                if (CPU_ISSET(cpus[i], &allowed) && node + 1 > num_nodes)
+                    num_nodes = node + 1;
+            }
+        }
+        closedir(dir);
+    }
+
+    // Kept until the process exits, since pools come and go
+    node_cpus = (cpu_set_t *)calloc(num_nodes, sizeof(cpu_set_t));
+    if (node_cpus == NULL)
+        exit(EXIT_FAILURE);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &allowed))
+            CPU_SET(cpu, &node_cpus[cpu_node[cpu]]);
+
+    for (int node = 0; node < num_nodes; node++)
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &node_cpus[node]))
+                compact_order[num_placements++] = cpu;
+
+    usable_nodes = (int *)malloc(num_nodes * sizeof(int));
+    if (usable_nodes == NULL)
+        exit(EXIT_FAILURE);
+    for (int node = 0; node < num_nodes; node++)
+        if (CPU_COUNT(&node_cpus[node]) > 0)
+            usable_nodes[num_usable_nodes++] = node;
+
+    // Round-robin over the nodes. Within a node, the first hyperthread of every core comes first
+    int max_rank = 0;
+    int ranks[CPU_SETSIZE];
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        ranks[cpu] = CPU_ISSET(cpu, &allowed) ? sibling_rank(cpu) : 0;
+        if (ranks[cpu] > max_rank)
+            max_rank = ranks[cpu];
+    }
+
+    // Each node's CPUs in (rank, cpu) order, then one from every node in turn
+    int *by_node = (int *)malloc(num_nodes * CPU_SETSIZE * sizeof(int));
+    size_t *count = (size_t *)calloc(num_nodes, sizeof(size_t));
+    if (by_node == NULL || count == NULL)
+        exit(EXIT_FAILURE);
+    for (int rank = 0; rank <= max_rank; rank++)
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &allowed) && ranks[cpu] == rank)
+            {
+                int node = cpu_node[cpu];
+                by_node[node * CPU_SETSIZE + count[node]++] = cpu;
+            }
+
+    size_t placed = 0;
+    for (size_t i = 0; placed < num_placements; i++)
+        for (int node = 0; node < num_nodes; node++)
+            if (i < count[node])
+                scatter_order[placed++] = by_node[node * CPU_SETSIZE + i];
+    free(by_node);
+    free(count);
+}
+
+void affinity_init()
+{
+    pthread_once(&topology_once, read_topology);
+}
+
+void affinity_bind(thread_data *td)
+{
+    td->cpu = -1;
+    td->node = -1;
+
+    const tholder_options *options = &td->pool->options;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    switch (options->affinity)
+    {
+    case THOLDER_AFFINITY_NONE:
+        return;
+    case THOLDER_AFFINITY_COMPACT:
+    case THOLDER_AFFINITY_SCATTER:
+        if (num_placements == 0)
+            return;
+        td->cpu = options->affinity == THOLDER_AFFINITY_COMPACT ? compact_order[td->index % num_placements]
+                                                                 : scatter_order[td->index % num_placements];
+        break;
+    case THOLDER_AFFINITY_LIST:
+        if (options->cpu_list_size == 0)
+            return;
+        td->cpu = options->cpu_list[td->index % options->cpu_list_size];
+        break;
+    case THOLDER_AFFINITY_NUMA:
+    {
+        // Take turns between the nodes that have CPUs we may use, CPU-less nodes get no workers
+        if (num_usable_nodes == 0)
+            return;
+        td->node = usable_nodes[td->index % num_usable_nodes];
+        set = node_cpus[td->node];
+        pthread_setaffinity_np(real_pthread_self(), sizeof(set), &set);
+        return;
+    }
+    }
+
+    if (td->cpu < 0 || td->cpu >= CPU_SETSIZE)
+    {
+        td->cpu = -1;
+        return;
+    }
+    CPU_SET(td->cpu, &set);
+    if (pthread_setaffinity_np(real_pthread_self(), sizeof(set), &set) != 0)
+    {
+        // Not a CPU we may use, leave the worker where it is
+        td->cpu = -1;
+        return;
+    }
+    td->node = cpu_node[td->cpu];
+}
+
+int affinity_num_nodes()
+{
+    return num_nodes;
+}
+
+void affinity_parse(const char *spec, tholder_options *opts)
+{
+    opts->affinity = THOLDER_AFFINITY_NONE;
+    opts->cpu_list = NULL;
+    opts->cpu_list_size = 0;
+    if (spec == NULL)
+        return;
+
+    if (strcmp(spec, "compact") == 0)
+        opts->affinity = THOLDER_AFFINITY_COMPACT;
+    else if (strcmp(spec, "scatter") == 0)
+        opts->affinity = THOLDER_AFFINITY_SCATTER;
+    else if (strcmp(spec, "numa") == 0)
+        opts->affinity = THOLDER_AFFINITY_NUMA;
+    else
+    {
+        opts->cpu_list_size = parse_cpu_list(spec, env_cpu_list, CPU_SETSIZE);
+        if (opts->cpu_list_size > 0)
+        {
+            opts->affinity = THOLDER_AFFINITY_LIST;
+            opts->cpu_list = env_cpu_list;
+        }
+    }
+}
+
+int tholder_node_of(const void *addr)
+{
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, NULL, 0, addr, MPOL_F_NODE | MPOL_F_ADDR) != 0)
+        return -1;
+    return node;
+}
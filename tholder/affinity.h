@@ -0,0 +1,21 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include "tholder.h"
+
+// Worker placement for the `affinity` option. Topology comes from sysfs, so there is no libnuma dependency
+
+// Reads the CPUs this process may run on and the NUMA node of each. Only the first call does anything,
+// the topology is shared by every pool
+void affinity_init();
+
+// Pins the calling worker thread according to its pool's `affinity` option and fills in td->cpu and td->node
+void affinity_bind(thread_data *td);
+
+// Highest NUMA node id with a CPU we may run on, plus one
+int affinity_num_nodes();
+
+// Sets the affinity options from a THOLDER_AFFINITY value, NULL leaves them off
+void affinity_parse(const char *spec, tholder_options *opts);
+
+#endif
@@ -0,0 +1,33 @@
+#include "tholder.h"
+#include "tholder_internal.h"
+
+void tholder_cancel_init(tholder_cancel_t *token, tholder_cancel_t *parent)
+{
+    atomic_init(&token->cancelled, false);
+    token->parent = parent;
+}
+
+void tholder_cancel(tholder_cancel_t *token)
+{
+    atomic_store_explicit(&token->cancelled, true, memory_order_release);
+}
+
+bool tholder_is_cancelled(const tholder_cancel_t *token)
+{
+    // Tokens are not told about their children, so the children look up the chain instead.
+    // Trees are shallow, and a token nobody cancelled costs one load per level
+    for (; token != NULL; token = token->parent)
+        if (atomic_load_explicit(&token->cancelled, memory_order_acquire))
+            return true;
+    return false;
+}
+
+tholder_cancel_t *tholder_current_cancel()
+{
+    return current_cancel();
+}
+
+bool tholder_cancel_requested()
+{
+    return tholder_is_cancelled(current_cancel());
+}
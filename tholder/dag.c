@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+#include "task_queue.h"
+
+// Marks a successor list that has already been released, so later tasks do not wait on its node
+#define SUCCESSORS_CLOSED ((dag_edge *)1)
+
+typedef struct dag_edge
+{
+    struct dag_edge *next;
+    struct dag_node *node;
+} dag_edge;
+
+typedef struct dag_node
+{
+    void *(*fn)(void *);
+    void *arg;
+    struct tholder_dag *dag;
+
+    // Unfinished predecessors, plus one held by tholder_dag_submit() until every edge is added
+    atomic_size_t pending;
+    // Lock-free stack of tasks waiting on this one, SUCCESSORS_CLOSED once it is done
+    _Atomic(dag_edge *) successors;
+    // Next node in the DAG's list of everything submitted since the last wait
+    struct dag_node *next;
+} dag_node;
+
+struct tholder_dag
+{
+    // Serializes submissions, which update the handles
+    pthread_mutex_t lock;
+    // Counts tasks from submission until they are done
+    tholder_group_t group;
+    // Where the tasks run, the pool of whoever created the DAG
+    tholder_pool_t *pool;
+    dag_node *nodes;
+    unsigned long long generation;
+};
+
+// Generations are unique across DAGs, so a handle used with another DAG is never mistaken as current
+static atomic_ullong next_generation = 1;
+
+static void *checked_malloc(size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr == NULL)
+        exit(EXIT_FAILURE);
+    return ptr;
+}
+
+static void *dag_run(void *args);
+
+// Queues a node whose predecessors are all done
+static void dag_ready(dag_node *node)
+{
+    task t = {dag_run, node, NULL, &node->dag->group};
+    if (submit_task(node->dag->pool, &t, NULL) != 0)
+    {
+        // Rejected by the pool, run it here
+        dag_run(node);
+        group_task_done(&node->dag->group);
+    }
+}
+
+static void *dag_run(void *args)
+{
+    dag_node *node = (dag_node *)args;
+    node->fn(node->arg);
+
+    // Release the successors. The group count is only dropped after this returns,
+    // so tholder_dag_wait() cannot free a node that is still being released
+    dag_edge *edge = atomic_exchange(&node->successors, SUCCESSORS_CLOSED);
+    while (edge != NULL)
+    {
+        dag_edge *next = edge->next;
+        if (atomic_fetch_sub(&edge->node->pending, 1) == 1)
+            dag_ready(edge->node);
+        free(edge);
+        edge = next;
+    }
+    return NULL;
+}
+
+// Makes `node` wait for `pred`, unless `pred` is already done
+static void add_edge(dag_node *pred, dag_node *node)
+{
+    if (pred == NULL || pred == node)
+        return;
+
+    dag_edge *edge = (dag_edge *)checked_malloc(sizeof(dag_edge));
+    edge->node = node;
+    atomic_fetch_add(&node->pending, 1);
+
+    dag_edge *head = atomic_load(&pred->successors);
+    do
+    {
+        if (head == SUCCESSORS_CLOSED)
+        {
+            atomic_fetch_sub(&node->pending, 1);
+            free(edge);
+            return;
+        }
+        edge->next = head;
+    } while (!atomic_compare_exchange_weak(&pred->successors, &head, edge));
+}
+
+tholder_dag_t *tholder_dag_create()
+{
+    tholder_pool_t *pool = submit_pool();
+    tholder_dag_t *dag = (tholder_dag_t *)checked_malloc(sizeof(tholder_dag_t));
+    dag->pool = pool;
+    pthread_mutex_init(&dag->lock, NULL);
+    tholder_group_init(&dag->group);
+    dag->nodes = NULL;
+    dag->generation = atomic_fetch_add(&next_generation, 1);
+    return dag;
+}
+
+int tholder_dag_submit(tholder_dag_t *dag, void *(*fn)(void *), void *arg, const tholder_dep_t *deps, size_t num_deps)
+{
+    dag_node *node = (dag_node *)checked_malloc(sizeof(dag_node));
+    node->fn = fn;
+    node->arg = arg;
+    node->dag = dag;
+    atomic_init(&node->pending, 1);
+    atomic_init(&node->successors, NULL);
+
+    // Counted before it can run, so a wait that starts now includes it
+    atomic_fetch_add(&dag->group.state, 1);
+
+    pthread_mutex_lock(&dag->lock);
+    node->next = dag->nodes;
+    dag->nodes = node;
+
+    for (size_t i = 0; i < num_deps; i++)
+    {
+        tholder_handle_t *handle = deps[i].handle;
+        if (handle->generation != dag->generation)
+        {
+            // Everything the handle remembers is from before the last wait, and done
+            handle->last_writer = NULL;
+            handle->num_readers = 0;
+            handle->generation = dag->generation;
+        }
+
+        add_edge(handle->last_writer, node);
+
+        if (deps[i].access == THOLDER_READ)
+        {
+            if (handle->num_readers == handle->readers_capacity)
+            {
+                handle->readers_capacity = handle->readers_capacity == 0 ? 4 : 2 * handle->readers_capacity;
+                handle->readers = (dag_node **)realloc(handle->readers, handle->readers_capacity * sizeof(dag_node *));
+                if (handle->readers == NULL)
+                    exit(EXIT_FAILURE);
+            }
+            handle->readers[handle->num_readers++] = node;
+        }
+        else
+        {
+            for (size_t r = 0; r < handle->num_readers; r++)
+                add_edge(handle->readers[r], node);
+            handle->num_readers = 0;
+            handle->last_writer = node;
+        }
+    }
+    pthread_mutex_unlock(&dag->lock);
+
+    // Drop the submission guard. If every predecessor is already done, the task is ready
+    if (atomic_fetch_sub(&node->pending, 1) == 1)
+        dag_ready(node);
+    return 0;
+}
+
+void tholder_dag_wait(tholder_dag_t *dag)
+{
+    tholder_group_wait(&dag->group);
+
+    // Every node is done, so handles only need to forget them. Bumping the generation does that lazily
+    pthread_mutex_lock(&dag->lock);
+    while (dag->nodes != NULL)
+    {
+        dag_node *next = dag->nodes->next;
+        free(dag->nodes);
+        dag->nodes = next;
+    }
+    dag->generation = atomic_fetch_add(&next_generation, 1);
+    pthread_mutex_unlock(&dag->lock);
+}
+
+void tholder_dag_destroy(tholder_dag_t *dag)
+{
+    tholder_dag_wait(dag);
+    pthread_mutex_destroy(&dag->lock);
+    free(dag);
+}
+
+void tholder_handle_destroy(tholder_handle_t *handle)
+{
+    free(handle->readers);
+    *handle = (tholder_handle_t)THOLDER_HANDLE_INIT;
+}
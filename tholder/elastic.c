@@ -0,0 +1,161 @@
+#include <stdlib.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+
+// The controller samples the pool this many times per `elastic_period_ms`
+#define ELASTIC_SAMPLES 10
+// Utilization has to leave the target by this many percent before the controller acts on it
+#define ELASTIC_BAND 10
+// Periods in a row below the band before the target shrinks. Growing takes one
+#define ELASTIC_SHRINK_PERIODS 3
+
+// Averages of the samples taken over one period
+typedef struct elastic_window
+{
+    size_t live;
+    size_t busy;
+    size_t queued;
+    int samples;
+} elastic_window;
+
+// Workers that are available to run tasks: not asleep in a join and not on their way out
+static long available_workers(tholder_pool_t *pool)
+{
+    return (long)atomic_load(&pool->live_threads) - (long)atomic_load(&pool->blocked_threads) -
+           (long)atomic_load(&pool->retiring_threads);
+}
+
+static size_t queued_tasks(tholder_pool_t *pool)
+{
+    size_t queued = task_queue_size(&pool->pending_tasks) + task_queue_size(&pool->high_tasks) +
+                    task_queue_size(&pool->background_tasks);
+    for (int node = 0; node < pool->num_node_queues; node++)
+        queued += task_queue_size(&pool->node_tasks[node]);
+    return queued;
+}
+
+static size_t max_target(tholder_pool_t *pool)
+{
+    if (pool->options.max_workers != 0)
+        return pool->options.max_workers;
+    return POOL_SEGMENT_SIZE * POOL_MAX_SEGMENTS;
+}
+
+// Moves the target toward the worker count that would keep `target_utilization` percent busy.
+// `quiet` counts the periods in a row below the band
+static void elastic_decide(tholder_pool_t *pool, const elastic_window *w, int *quiet)
+{
+    unsigned int goal = pool->options.target_utilization;
+    size_t target = atomic_load(&pool->target_workers);
+
+    // Workers asleep in a join count as busy, they hold on to a thread all the same
+    unsigned int utilization = w->live == 0 ? (w->queued > 0 ? 100 : 0) : (unsigned int)(w->busy * 100 / w->live);
+    atomic_store(&pool->utilization, utilization);
+
+    // Rounded up, so a single busy worker still needs one
+    size_t needed = (w->busy * 100 + (size_t)goal * w->samples - 1) / ((size_t)goal * w->samples);
+    if (needed < pool->options.min_workers)
+        needed = pool->options.min_workers;
+
+    // Grow right away when the workers are overloaded or tasks keep waiting while they are all busy.
+    // Tasks that are only queued for a moment under light load do not count
+    bool backlog = w->queued >= (size_t)w->samples && utilization >= goal;
+    if (utilization > goal + ELASTIC_BAND || backlog)
+    {
+        *quiet = 0;
+        size_t grown = needed > target ? needed : target + 1;
+        if (grown > max_target(pool))
+            grown = max_target(pool);
+        if (grown > target)
+        {
+            atomic_store(&pool->target_workers, grown);
+            atomic_fetch_add(&pool->elastic_grows, 1);
+        }
+        return;
+    }
+
+    if (utilization + ELASTIC_BAND >= goal || needed >= target)
+    {
+        *quiet = 0;
+        return;
+    }
+
+    // Shrink only after a few quiet periods, and by half the distance, so a pause between two bursts
+    // does not cost the workers the second one needs
+    if (++*quiet < ELASTIC_SHRINK_PERIODS)
+        return;
+    *quiet = 0;
+    atomic_store(&pool->target_workers, target - (target - needed + 1) / 2);
+    atomic_fetch_add(&pool->elastic_shrinks, 1);
+}
+
+static void *elastic_controller(void *args)
+{
+    tholder_pool_t *pool = (tholder_pool_t *)args;
+    long sample_ns = pool->options.elastic_period_ms * 1000000L / ELASTIC_SAMPLES;
+    elastic_window window = {0};
+    int quiet = 0;
+
+    while (atomic_load(&pool->controller_stop) == 0)
+    {
+        // Bring the pool up to the target, so the next burst finds workers parked instead of paying
+        // for pthread_create. Surplus workers retire on their own once they idle for a period
+        while (available_workers(pool) < (long)atomic_load(&pool->target_workers) && spawn_worker(pool, NULL) == 0)
+            ;
+
+        futex_wait(&pool->controller_stop, 0, sample_ns);
+
+        long live = (long)atomic_load(&pool->live_threads) - (long)atomic_load(&pool->retiring_threads);
+        long busy = live - (long)atomic_load(&pool->idle_threads);
+        window.live += live > 0 ? (size_t)live : 0;
+        window.busy += busy > 0 ? (size_t)busy : 0;
+        window.queued += queued_tasks(pool);
+
+        if (++window.samples == ELASTIC_SAMPLES)
+        {
+            elastic_decide(pool, &window, &quiet);
+            window = (elastic_window){0};
+        }
+    }
+    return NULL;
+}
+
+void elastic_start(tholder_pool_t *pool)
+{
+    if (pool->options.min_workers == 0)
+        pool->options.min_workers = 1;
+    if (pool->options.target_utilization == 0 || pool->options.target_utilization > 100)
+        pool->options.target_utilization = DEFAULT_TARGET_UTILIZATION;
+    if (pool->options.elastic_period_ms <= 0)
+        pool->options.elastic_period_ms = DEFAULT_ELASTIC_PERIOD_MS;
+
+    size_t target = pool->options.min_workers < max_target(pool) ? pool->options.min_workers : max_target(pool);
+    atomic_store(&pool->target_workers, target);
+    atomic_store(&pool->retiring_threads, 0);
+    atomic_store(&pool->controller_stop, 0);
+    atomic_store(&pool->utilization, 0);
+    atomic_store(&pool->elastic_grows, 0);
+    atomic_store(&pool->elastic_shrinks, 0);
+
+    if (real_pthread_create(&pool->controller, NULL, elastic_controller, pool) != 0)
+        exit(EXIT_FAILURE);
+}
+
+void elastic_stop(tholder_pool_t *pool)
+{
+    atomic_store(&pool->controller_stop, 1);
+    futex_wake(&pool->controller_stop, 1);
+    real_pthread_join(pool->controller, NULL);
+}
+
+bool elastic_retire(tholder_pool_t *pool)
+{
+    // Count ourselves out first, so two workers timing out together cannot both leave the pool short
+    atomic_fetch_add(&pool->retiring_threads, 1);
+    if (available_workers(pool) >= (long)atomic_load(&pool->target_workers))
+        return true;
+
+    atomic_fetch_sub(&pool->retiring_threads, 1);
+    return false;
+}
@@ -0,0 +1,367 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+#include "fiber.h"
+#include "trace.h"
+
+// x86-64 switches stacks with a few instructions of its own. Elsewhere, or with THOLDER_FIBER_UCONTEXT,
+// swapcontext() does it, at the price of a system call per switch for the signal mask
+#if defined(__x86_64__) && !defined(THOLDER_FIBER_UCONTEXT)
+#define FIBER_ASM_SWITCH
+#else
+#include <ucontext.h>
+#endif
+
+// Fibers a worker keeps for reuse. Beyond that, finished fibers give their stacks back
+#define FIBER_CACHE_MAX 64
+
+typedef struct fiber_context
+{
+#ifdef FIBER_ASM_SWITCH
+    // Stack pointer of a switched-out context, with its callee-saved registers on top
+    void *sp;
+#else
+    ucontext_t uc;
+#endif
+} fiber_context;
+
+// What a fiber asks its worker to do when it switches back
+typedef enum fiber_request
+{
+    FIBER_FINISHED,
+    // Suspend until `joined` is done
+    FIBER_JOIN,
+    // Resume it once the worker has run another task
+    FIBER_YIELD
+} fiber_request;
+
+struct fiber
+{
+    fiber_context context;
+    // Mapping of the stack, whose lowest page is a guard
+    void *stack;
+    size_t stack_size;
+    tholder_pool_t *pool;
+
+    // The task it runs
+    task t;
+    fiber_request request;
+    task_output *joined;
+
+    // Next entry while it sits in a worker's cache or yielded list
+    struct fiber *next_free;
+};
+
+// Fiber state of one worker
+typedef struct fiber_worker
+{
+    // Where fibers switch back to, on the worker's own stack
+    fiber_context scheduler;
+    struct fiber *current;
+    struct fiber *free_list;
+    size_t free_count;
+    // Fibers that yielded, oldest first. They stay with this worker
+    struct fiber *yielded_head;
+    struct fiber *yielded_tail;
+} fiber_worker;
+
+static _Thread_local fiber_worker *local_fibers = NULL;
+
+#ifdef FIBER_ASM_SWITCH
+// Pushes the callee-saved registers, stores the stack pointer in *from, then loads `to` and pops its registers.
+// The `ret` returns to wherever `to` switched out, or to fiber_main() the first time. The floating point
+// control words are not switched, tasks are expected to leave them alone
+void tholder_fiber_switch(void **from, void *to);
+__asm__(".text\n"
+        ".globl tholder_fiber_switch\n"
+        ".hidden tholder_fiber_switch\n"
+        ".type tholder_fiber_switch, @function\n"
+        "tholder_fiber_switch:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size tholder_fiber_switch, .-tholder_fiber_switch\n");
+#endif
+
+static void context_switch(fiber_context *from, fiber_context *to)
+{
+#ifdef FIBER_ASM_SWITCH
+    tholder_fiber_switch(&from->sp, to->sp);
+#else
+    swapcontext(&from->uc, &to->uc);
+#endif
+}
+
+// A fiber may be resumed on another worker, so code that runs on one reads the thread-local state through
+// this call after every switch. Inlined, the compiler could keep the previous thread's address around
+static __attribute__((noinline)) fiber_worker *this_worker()
+{
+    return local_fibers;
+}
+
+// Entry point of every fiber. Runs one task per round, and is switched to again for the next one
+static void fiber_main()
+{
+    while (true)
+    {
+        struct fiber *f = this_worker()->current;
+        run_task(f->pool, &f->t);
+        f->request = FIBER_FINISHED;
+        context_switch(&f->context, &this_worker()->scheduler);
+    }
+}
+
+static void context_init(struct fiber *f)
+{
+    char *top = (char *)f->stack + f->stack_size;
+#ifdef FIBER_ASM_SWITCH
+    // Laid out as if fiber_main() had been called and then switched out: the callee-saved registers, then
+    // the address tholder_fiber_switch() returns to, then a return address for fiber_main(), which never returns
+    void (*entry)() = fiber_main;
+    void **sp = (void **)top;
+    *--sp = NULL;
+    memcpy(--sp, &entry, sizeof(entry));
+    for (int i = 0; i < 6; i++)
+        *--sp = NULL;
+    f->context.sp = sp;
+#else
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    getcontext(&f->context.uc);
+    f->context.uc.uc_stack.ss_sp = (char *)f->stack + page;
+    f->context.uc.uc_stack.ss_size = top - ((char *)f->stack + page);
+    f->context.uc.uc_link = NULL;
+    makecontext(&f->context.uc, fiber_main, 0);
+#endif
+}
+
+static struct fiber *fiber_create(tholder_pool_t *pool)
+{
+    struct fiber *f = (struct fiber *)malloc(sizeof(struct fiber));
+    if (f == NULL)
+        return NULL;
+
+    // Pages are only backed once touched, so a large stack costs address space, not memory.
+    // The guard page turns an overflow into a crash instead of silent corruption
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    f->stack_size = (pool->options.fiber_stack_size + page - 1) / page * page + page;
+    f->stack = mmap(NULL, f->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (f->stack == MAP_FAILED)
+    {
+        free(f);
+        return NULL;
+    }
+    mprotect(f->stack, page, PROT_NONE);
+
+    f->pool = pool;
+    context_init(f);
+    return f;
+}
+
+static void fiber_destroy(struct fiber *f)
+{
+    atomic_fetch_sub(&f->pool->fibers_allocated, 1);
+    munmap(f->stack, f->stack_size);
+    free(f);
+}
+
+// A fiber from the worker's cache, or a new one while the pool is under `max_fibers`. NULL otherwise
+static struct fiber *fiber_get(tholder_pool_t *pool, fiber_worker *fw)
+{
+    struct fiber *f = fw->free_list;
+    if (f != NULL)
+    {
+        fw->free_list = f->next_free;
+        fw->free_count--;
+        return f;
+    }
+
+    size_t allocated = atomic_load(&pool->fibers_allocated);
+    do
+    {
+        if (allocated >= pool->options.max_fibers)
+            return NULL;
+    } while (!atomic_compare_exchange_weak(&pool->fibers_allocated, &allocated, allocated + 1));
+
+    f = fiber_create(pool);
+    if (f == NULL)
+        atomic_fetch_sub(&pool->fibers_allocated, 1);
+    return f;
+}
+
+static void fiber_put(fiber_worker *fw, struct fiber *f)
+{
+    if (fw->free_count >= FIBER_CACHE_MAX)
+    {
+        fiber_destroy(f);
+        return;
+    }
+    f->next_free = fw->free_list;
+    fw->free_list = f;
+    fw->free_count++;
+}
+
+void fiber_worker_start(tholder_pool_t *pool)
+{
+    (void)pool;
+    local_fibers = (fiber_worker *)calloc(1, sizeof(fiber_worker));
+    if (local_fibers == NULL)
+        exit(EXIT_FAILURE);
+}
+
+void fiber_worker_stop(tholder_pool_t *pool)
+{
+    (void)pool;
+    while (local_fibers->free_list != NULL)
+    {
+        struct fiber *f = local_fibers->free_list;
+        local_fibers->free_list = f->next_free;
+        fiber_destroy(f);
+    }
+    free(local_fibers);
+    local_fibers = NULL;
+}
+
+// Switches to `f` until it finishes or is suspended
+static void fiber_enter(fiber_worker *fw, struct fiber *f)
+{
+    while (true)
+    {
+        fw->current = f;
+        context_switch(&fw->scheduler, &f->context);
+        fw->current = NULL;
+
+        switch (f->request)
+        {
+        case FIBER_FINISHED:
+            fiber_put(fw, f);
+            return;
+        case FIBER_YIELD:
+            f->next_free = NULL;
+            if (fw->yielded_tail != NULL)
+                fw->yielded_tail->next_free = f;
+            else
+                fw->yielded_head = f;
+            fw->yielded_tail = f;
+            return;
+        case FIBER_JOIN:
+        {
+            // The fiber is switched out completely by now, so whoever finishes the task may resume it right
+            // away, on any worker. From here on it is not ours to touch
+            task_output *output = f->joined;
+            output->waiter = f;
+            unsigned int state = OUTPUT_PENDING;
+            if (atomic_compare_exchange_strong(&output->state, &state, OUTPUT_FIBER_WAITED))
+                return;
+            // Done while it was switching out, so go right back
+            break;
+        }
+        }
+    }
+}
+
+void fiber_run(tholder_pool_t *pool, task *t)
+{
+    fiber_worker *fw = local_fibers;
+    struct fiber *f;
+
+    // Entries of `resumed_fibers` carry the fiber instead of a function
+    if (t->function == NULL)
+        f = (struct fiber *)t->args;
+    else
+    {
+        f = fiber_get(pool, fw);
+        // Out of fibers. The task runs on our own stack, and waits in its joins the usual way
+        if (f == NULL)
+        {
+            run_task(pool, t);
+            return;
+        }
+        f->t = *t;
+    }
+    fiber_enter(fw, f);
+}
+
+bool fiber_run_yielded()
+{
+    fiber_worker *fw = local_fibers;
+    struct fiber *f = fw->yielded_head;
+    if (f == NULL)
+        return false;
+
+    fw->yielded_head = f->next_free;
+    if (fw->yielded_head == NULL)
+        fw->yielded_tail = NULL;
+    fiber_enter(fw, f);
+    return true;
+}
+
+bool fiber_active()
+{
+    return local_fibers != NULL && local_fibers->current != NULL;
+}
+
+// Switches back to the worker with `request` set, and returns once some worker resumed the fiber
+static void fiber_suspend(struct fiber *f)
+{
+    if (tracing)
+        trace_record(TRACE_END, f->t.trace_id, f->t.function);
+
+    // The worker that resumes us may have been running anything in the meantime
+    tholder_pool_t *pool = swap_running_pool(NULL);
+    tholder_cancel_t *cancel = swap_running_cancel(NULL);
+    context_switch(&f->context, &this_worker()->scheduler);
+    swap_running_pool(pool);
+    swap_running_cancel(cancel);
+
+    if (tracing)
+        trace_record(TRACE_START, f->t.trace_id, f->t.function);
+}
+
+void fiber_join(task_output *output)
+{
+    struct fiber *f = this_worker()->current;
+    f->request = FIBER_JOIN;
+    f->joined = output;
+    fiber_suspend(f);
+}
+
+void fiber_wake(struct fiber *f)
+{
+    tholder_pool_t *pool = f->pool;
+    task resume = {NULL, f, NULL, NULL};
+
+    // Every fiber has at most one entry and the queue holds `max_fibers`, so this never spins for long
+    while (!task_queue_push(&pool->resumed_fibers, &resume))
+        cpu_relax();
+    wake_worker(pool, NULL);
+}
+
+void tholder_yield()
+{
+    if (!fiber_active())
+    {
+        sched_yield();
+        return;
+    }
+
+    struct fiber *f = this_worker()->current;
+    f->request = FIBER_YIELD;
+    fiber_suspend(f);
+}
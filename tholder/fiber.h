@@ -0,0 +1,35 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <stdbool.h>
+
+#include "tholder.h"
+#include "task_queue.h"
+
+// Fiber mode, see the `fibers` option. Every task runs on a fiber: a pooled stack of its own that the
+// worker switches to in user space. A task that waits is suspended, and resumed later on any worker of
+// its pool, instead of holding on to an OS thread
+
+struct fiber;
+
+// Sets up and tears down the fiber state of the calling worker of `pool`
+void fiber_worker_start(tholder_pool_t *pool);
+void fiber_worker_stop(tholder_pool_t *pool);
+
+// Runs `t` on a fiber of the calling worker, or continues the suspended fiber it stands for if it came
+// from `resumed_fibers`. Returns once the fiber finished or was suspended
+void fiber_run(tholder_pool_t *pool, task *t);
+
+// Continues the oldest fiber of the calling worker that yielded. Returns false if there was none
+bool fiber_run_yielded();
+
+// Whether the calling thread is running a task on a fiber
+bool fiber_active();
+
+// Suspends the calling fiber until `output` is done
+void fiber_join(task_output *output);
+
+// Queues a fiber suspended in fiber_join() on its pool again
+void fiber_wake(struct fiber *f);
+
+#endif
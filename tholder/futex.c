@@ -0,0 +1,81 @@
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "errno.h"
+
+#include "futex.h"
+#include "tholder_internal.h"
+
+int futex_wait(atomic_uint *word, unsigned int expected, long timeout_ns)
+{
+    struct timespec ts;
+    struct timespec *tsp = NULL;
+
+    if (timeout_ns >= 0)
+    {
+        ts.tv_sec = timeout_ns / 1000000000L;
+        ts.tv_nsec = timeout_ns % 1000000000L;
+        tsp = &ts;
+    }
+
+    if (syscall(SYS_futex, (unsigned int *)word, FUTEX_WAIT_PRIVATE, expected, tsp, NULL, 0) == -1)
+        return errno;
+    return 0;
+}
+
+void futex_wake(atomic_uint *word, int count)
+{
+    syscall(SYS_futex, (unsigned int *)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+void futex_sem_init(futex_sem *sem, unsigned int value)
+{
+    atomic_init(&sem->tokens, value);
+    atomic_init(&sem->waiters, 0);
+}
+
+void futex_sem_post(futex_sem *sem)
+{
+    atomic_fetch_add(&sem->tokens, 1);
+    // Pairs with the increment of `waiters` in futex_sem_timedwait(): either we see the
+    // sleeper, or the kernel sees our token when it compares the futex word
+    if (atomic_load(&sem->waiters) > 0)
+        futex_wake(&sem->tokens, 1);
+}
+
+bool futex_sem_trywait(futex_sem *sem)
+{
+    unsigned int tokens = atomic_load(&sem->tokens);
+    while (tokens > 0)
+    {
+        if (atomic_compare_exchange_weak(&sem->tokens, &tokens, tokens - 1))
+            return true;
+    }
+    return false;
+}
+
+int futex_sem_timedwait(futex_sem *sem, long timeout_ns)
+{
+    unsigned long long deadline = timeout_ns >= 0 ? now_ns() + (unsigned long long)timeout_ns : ULLONG_MAX;
+
+    while (true)
+    {
+        if (futex_sem_trywait(sem))
+            return 0;
+
+        long remaining = -1;
+        if (timeout_ns >= 0)
+        {
+            unsigned long long now = now_ns();
+            if (now >= deadline)
+                return ETIMEDOUT;
+            remaining = (long)(deadline - now);
+        }
+
+        atomic_fetch_add(&sem->waiters, 1);
+        futex_wait(&sem->tokens, 0, remaining);
+        atomic_fetch_sub(&sem->waiters, 1);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Sleeps while `*word == expected`. A negative `timeout_ns` waits forever.
+// Returns 0 when woken (possibly spuriously), ETIMEDOUT, EAGAIN if the value already changed, or EINTR
+int futex_wait(atomic_uint *word, unsigned int expected, long timeout_ns);
+
+// Wakes up to `count` threads sleeping on `word`
+void futex_wake(atomic_uint *word, int count);
+
+// Counting semaphore on a single futex word. Posting is a single atomic add
+// unless somebody is actually asleep
+typedef struct futex_sem
+{
+    atomic_uint tokens;
+    atomic_uint waiters;
+} futex_sem;
+
+void futex_sem_init(futex_sem *sem, unsigned int value);
+
+void futex_sem_post(futex_sem *sem);
+
+// Consumes a token without sleeping. Returns false if there was none
+bool futex_sem_trywait(futex_sem *sem);
+
+// Returns 0 once a token was consumed, or ETIMEDOUT. A negative `timeout_ns` waits forever
+int futex_sem_timedwait(futex_sem *sem, long timeout_ns);
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdlib.h>
+#include <limits.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+#include "task_queue.h"
+#include "futex.h"
+
+// Values of tholder_future::state, the same protocol tholder_join() uses on task_output
+enum
+{
+    FUTURE_PENDING,
+    FUTURE_DONE,
+    FUTURE_WAITED
+};
+
+// Marks a callback list that has already been run, so callbacks added later run right away
+#define CALLBACKS_CLOSED ((future_callback *)1)
+
+// Runs once the future it was added to completes
+typedef struct future_callback
+{
+    struct future_callback *next;
+    void (*fn)(tholder_future_t *done, void *ctx);
+    void *ctx;
+} future_callback;
+
+struct tholder_future
+{
+    void *value;
+    // Doubles as the futex word tholder_future_get() sleeps on
+    atomic_uint state;
+    // The caller's reference plus one per task or combinator that still has to complete the future
+    atomic_uint refs;
+    // Lock-free stack of callbacks, CALLBACKS_CLOSED once the future is done
+    _Atomic(future_callback *) callbacks;
+};
+
+// A continuation waiting for `from` before it can compute `to`
+typedef struct then_node
+{
+    tholder_future_t *from;
+    tholder_future_t *to;
+    tholder_continuation_fn fn;
+    void *ctx;
+} then_node;
+
+// Shared by the callbacks of one tholder_when_all() or tholder_when_any()
+typedef struct combine_node
+{
+    tholder_future_t *to;
+    atomic_size_t remaining;
+    atomic_bool fired;
+} combine_node;
+
+typedef struct async_node
+{
+    tholder_future_t *future;
+    void *(*fn)(void *);
+    void *arg;
+} async_node;
+
+static void *checked_malloc(size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr == NULL)
+        exit(EXIT_FAILURE);
+    return ptr;
+}
+
+static tholder_future_t *future_new(unsigned int refs)
+{
+    tholder_future_t *future = (tholder_future_t *)checked_malloc(sizeof(tholder_future_t));
+    future->value = NULL;
+    atomic_init(&future->state, FUTURE_PENDING);
+    atomic_init(&future->refs, refs);
+    atomic_init(&future->callbacks, NULL);
+    return future;
+}
+
+static void future_complete(tholder_future_t *future, void *value)
+{
+    future->value = value;
+    if (atomic_exchange(&future->state, FUTURE_DONE) == FUTURE_WAITED)
+        futex_wake(&future->state, INT_MAX);
+
+    future_callback *callback = atomic_exchange(&future->callbacks, CALLBACKS_CLOSED);
+    while (callback != NULL)
+    {
+        future_callback *next = callback->next;
+        callback->fn(future, callback->ctx);
+        free(callback);
+        callback = next;
+    }
+}
+
+// Calls `fn(future, ctx)` once `future` is done, right away if it already is
+static void future_on_complete(tholder_future_t *future, void (*fn)(tholder_future_t *, void *), void *ctx)
+{
+    future_callback *callback = (future_callback *)checked_malloc(sizeof(future_callback));
+    callback->fn = fn;
+    callback->ctx = ctx;
+
+    future_callback *head = atomic_load(&future->callbacks);
+    do
+    {
+        if (head == CALLBACKS_CLOSED)
+        {
+            free(callback);
+            fn(future, ctx);
+            return;
+        }
+        callback->next = head;
+    } while (!atomic_compare_exchange_weak(&future->callbacks, &head, callback));
+}
+
+// Queues `fn(arg)` as a detached task. If the pool rejects it, it runs here instead
+static void future_submit(void *(*fn)(void *), void *arg)
+{
+    task t = {fn, arg, NULL, NULL};
+    if (submit_task(submit_pool(), &t, NULL) != 0)
+        fn(arg);
+}
+
+static void *async_task(void *args)
+{
+    async_node *node = (async_node *)args;
+    future_complete(node->future, node->fn(node->arg));
+    tholder_future_release(node->future);
+    free(node);
+    return NULL;
+}
+
+tholder_future_t *tholder_async(void *(*fn)(void *), void *arg)
+{
+    // One reference for the caller, one for the task
+    tholder_future_t *future = future_new(2);
+
+    async_node *node = (async_node *)checked_malloc(sizeof(async_node));
+    node->future = future;
+    node->fn = fn;
+    node->arg = arg;
+    future_submit(async_task, node);
+    return future;
+}
+
+static void *then_task(void *args)
+{
+    then_node *node = (then_node *)args;
+    future_complete(node->to, node->fn(node->from->value, node->ctx));
+    tholder_future_release(node->to);
+    tholder_future_release(node->from);
+    free(node);
+    return NULL;
+}
+
+static void then_ready(tholder_future_t *done, void *ctx)
+{
+    (void)done;
+    future_submit(then_task, ctx);
+}
+
+tholder_future_t *tholder_then(tholder_future_t *future, tholder_continuation_fn fn, void *ctx)
+{
+    tholder_future_t *next = future_new(2);
+
+    // Keep `future` alive until the continuation has read its value
+    atomic_fetch_add(&future->refs, 1);
+
+    then_node *node = (then_node *)checked_malloc(sizeof(then_node));
+    node->from = future;
+    node->to = next;
+    node->fn = fn;
+    node->ctx = ctx;
+    future_on_complete(future, then_ready, node);
+    return next;
+}
+
+static void all_ready(tholder_future_t *done, void *ctx)
+{
+    (void)done;
+    combine_node *node = (combine_node *)ctx;
+    if (atomic_fetch_sub(&node->remaining, 1) == 1)
+    {
+        future_complete(node->to, NULL);
+        tholder_future_release(node->to);
+        free(node);
+    }
+}
+
+static void any_ready(tholder_future_t *done, void *ctx)
+{
+    combine_node *node = (combine_node *)ctx;
+    if (!atomic_exchange(&node->fired, true))
+        future_complete(node->to, done->value);
+
+    // The node is shared by every input, so the last one frees it
+    if (atomic_fetch_sub(&node->remaining, 1) == 1)
+    {
+        tholder_future_release(node->to);
+        free(node);
+    }
+}
+
+static tholder_future_t *combine(tholder_future_t *const *futures, size_t count,
+                                 void (*ready)(tholder_future_t *, void *))
+{
+    if (count == 0)
+    {
+        tholder_future_t *future = future_new(1);
+        future_complete(future, NULL);
+        return future;
+    }
+
+    tholder_future_t *future = future_new(2);
+    combine_node *node = (combine_node *)checked_malloc(sizeof(combine_node));
+    node->to = future;
+    atomic_init(&node->remaining, count);
+    atomic_init(&node->fired, false);
+
+    for (size_t i = 0; i < count; i++)
+        future_on_complete(futures[i], ready, node);
+    return future;
+}
+
+tholder_future_t *tholder_when_all(tholder_future_t *const *futures, size_t count)
+{
+    return combine(futures, count, all_ready);
+}
+
+tholder_future_t *tholder_when_any(tholder_future_t *const *futures, size_t count)
+{
+    return combine(futures, count, any_ready);
+}
+
+bool tholder_future_ready(tholder_future_t *future)
+{
+    return atomic_load(&future->state) == FUTURE_DONE;
+}
+
+void *tholder_future_get(tholder_future_t *future)
+{
+    // Same as tholder_join(): help with queued tasks, then spin, then sleep
+    tholder_pool_t *pool = current_pool();
+    while (atomic_load(&future->state) != FUTURE_DONE)
+    {
+        if (atomic_load(&pool->initialized) && help_one_task(pool))
+            continue;
+
+        for (unsigned int i = 0; i < pool->options.spin_iterations; i++)
+        {
+            if (atomic_load(&future->state) == FUTURE_DONE)
+                break;
+            cpu_relax();
+        }
+
+        unsigned int state = FUTURE_PENDING;
+        if (!atomic_compare_exchange_strong(&future->state, &state, FUTURE_WAITED) && state == FUTURE_DONE)
+            break;
+
+        if (atomic_load(&pool->initialized) && !blocking_begin(pool))
+            continue;
+        while (atomic_load(&future->state) != FUTURE_DONE)
+            futex_wait(&future->state, FUTURE_WAITED, -1);
+        if (atomic_load(&pool->initialized))
+            blocking_end();
+    }
+
+    return future->value;
+}
+
+void tholder_future_release(tholder_future_t *future)
+{
+    if (atomic_fetch_sub(&future->refs, 1) == 1)
+        free(future);
+}
@@ -0,0 +1,83 @@
+#include <limits.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+#include "task_queue.h"
+#include "futex.h"
+#include "trace.h"
+
+#define GROUP_WAITER_BIT 0x80000000u
+#define GROUP_COUNT_MASK (~GROUP_WAITER_BIT)
+
+void tholder_group_init(tholder_group_t *group)
+{
+    atomic_init(&group->state, 0);
+    group->cancel = NULL;
+}
+
+void tholder_group_set_cancel(tholder_group_t *group, tholder_cancel_t *token)
+{
+    group->cancel = token;
+}
+
+int tholder_group_spawn(tholder_group_t *group, void *(*__start_routine)(void *), void *__arg)
+{
+    tholder_pool_t *pool = submit_pool();
+    atomic_fetch_add(&group->state, 1);
+
+    task t = {__start_routine, __arg, NULL, group};
+    t.cancel = group->cancel != NULL ? group->cancel : current_cancel();
+    int ret = submit_task(pool, &t, NULL);
+    if (ret != 0)
+        group_task_done(group);
+    return ret;
+}
+
+void group_task_done(tholder_group_t *group)
+{
+    // Only the last task wakes the waiter. The group may be gone as soon as the count hits zero,
+    // so the wake is the last thing that touches it (waking a stale address is harmless)
+    if (atomic_fetch_sub(&group->state, 1) == (GROUP_WAITER_BIT | 1))
+        futex_wake(&group->state, INT_MAX);
+}
+
+void tholder_group_wait(tholder_group_t *group)
+{
+    unsigned int state;
+    tholder_pool_t *pool = current_pool();
+    if (tracing)
+        trace_record(TRACE_GROUP_WAIT_BEGIN, 0, NULL);
+
+    while (((state = atomic_load(&group->state)) & GROUP_COUNT_MASK) != 0)
+    {
+        // Run queued tasks (often our own group's) instead of sitting idle
+        if (help_one_task(pool))
+            continue;
+
+        // The tasks are running somewhere, spin before sleeping
+        for (unsigned int i = 0; i < pool->options.spin_iterations; i++)
+        {
+            if ((atomic_load(&group->state) & GROUP_COUNT_MASK) == 0)
+                break;
+            cpu_relax();
+        }
+
+        // Tell the last task to wake us up
+        state = atomic_load(&group->state);
+        if ((state & GROUP_COUNT_MASK) == 0)
+            break;
+        if (!(state & GROUP_WAITER_BIT) &&
+            !atomic_compare_exchange_strong(&group->state, &state, state | GROUP_WAITER_BIT))
+            continue;
+
+        if (!blocking_begin(pool))
+            continue;
+        while (((state = atomic_load(&group->state)) & GROUP_COUNT_MASK) != 0)
+            futex_wait(&group->state, state, -1);
+        blocking_end();
+    }
+
+    atomic_store(&group->state, 0);
+    if (tracing)
+        trace_record(TRACE_GROUP_WAIT_END, 0, NULL);
+}
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "output_slab.h"
+
+typedef struct output_slab
+{
+    struct output_slab *next;
+    task_output outputs[OUTPUT_SLAB_SIZE];
+} output_slab;
+
+atomic_size_t task_output_allocations = 0;
+
+// Every slab ever allocated, so they can be freed in output_slab_destroy()
+static output_slab *slabs = NULL;
+// task_outputs handed back by threads whose free list overflowed
+static task_output *shared_free = NULL;
+static size_t shared_free_count = 0;
+static pthread_mutex_t slab_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Bumped by output_slab_destroy() so threads drop free lists that point into freed slabs
+static atomic_size_t slab_generation = 0;
+
+static _Thread_local task_output *local_free = NULL;
+static _Thread_local size_t local_free_count = 0;
+static _Thread_local size_t local_generation = 0;
+
+static void check_generation()
+{
+    size_t generation = atomic_load(&slab_generation);
+    if (local_generation != generation)
+    {
+        local_free = NULL;
+        local_free_count = 0;
+        local_generation = generation;
+    }
+}
+
+// Refills this thread's free list. Must be called with slab_lock held
+static void refill_local()
+{
+    if (shared_free != NULL)
+    {
+        // Take a slab's worth, so threads refilling at the same time do not leave each other with nothing
+        task_output *last = shared_free;
+        size_t taken = 1;
+        while (taken < OUTPUT_SLAB_SIZE && last->next_free != NULL)
+        {
+            last = last->next_free;
+            taken++;
+        }
+        local_free = shared_free;
+        local_free_count = taken;
+        shared_free = last->next_free;
+        shared_free_count -= taken;
+        last->next_free = NULL;
+        return;
+    }
+
+    output_slab *slab = (output_slab *)calloc(1, sizeof(output_slab));
+    if (slab == NULL)
+        exit(EXIT_FAILURE);
+    atomic_fetch_add(&task_output_allocations, 1);
+
+    slab->next = slabs;
+    slabs = slab;
+
+    for (size_t i = 0; i < OUTPUT_SLAB_SIZE; i++)
+    {
+        slab->outputs[i].next_free = local_free;
+        local_free = &slab->outputs[i];
+    }
+    local_free_count = OUTPUT_SLAB_SIZE;
+}
+
+task_output *output_slab_alloc()
+{
+    check_generation();
+
+    if (local_free == NULL)
+    {
+        pthread_mutex_lock(&slab_lock);
+        refill_local();
+        pthread_mutex_unlock(&slab_lock);
+    }
+
+    task_output *output = local_free;
+    local_free = output->next_free;
+    local_free_count--;
+    return output;
+}
+
+void output_slab_free(task_output *output)
+{
+    check_generation();
+
+    output->next_free = local_free;
+    local_free = output;
+    local_free_count++;
+
+    if (local_free_count <= OUTPUT_CACHE_MAX)
+        return;
+
+    // Give half of the list back so a thread that only joins does not hoard everything
+    size_t keep = OUTPUT_CACHE_MAX / 2;
+    task_output *last = local_free;
+    for (size_t i = 1; i < keep; i++)
+        last = last->next_free;
+    task_output *extra = last->next_free;
+    size_t extra_count = local_free_count - keep;
+    last->next_free = NULL;
+    local_free_count = keep;
+
+    task_output *tail = extra;
+    while (tail->next_free != NULL)
+        tail = tail->next_free;
+
+    pthread_mutex_lock(&slab_lock);
+    tail->next_free = shared_free;
+    shared_free = extra;
+    shared_free_count += extra_count;
+    pthread_mutex_unlock(&slab_lock);
+}
+
+void output_slab_thread_exit()
+{
+    // A list from before output_slab_destroy() points into freed slabs
+    if (local_free == NULL || local_generation != atomic_load(&slab_generation))
+        return;
+
+    task_output *tail = local_free;
+    while (tail->next_free != NULL)
+        tail = tail->next_free;
+
+    pthread_mutex_lock(&slab_lock);
+    tail->next_free = shared_free;
+    shared_free = local_free;
+    shared_free_count += local_free_count;
+    pthread_mutex_unlock(&slab_lock);
+
+    local_free = NULL;
+    local_free_count = 0;
+}
+
+void output_slab_destroy()
+{
+    pthread_mutex_lock(&slab_lock);
+    while (slabs != NULL)
+    {
+        output_slab *next = slabs->next;
+        free(slabs);
+        slabs = next;
+    }
+    shared_free = NULL;
+    shared_free_count = 0;
+    atomic_fetch_add(&slab_generation, 1);
+    pthread_mutex_unlock(&slab_lock);
+}
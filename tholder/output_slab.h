@@ -0,0 +1,26 @@
+#ifndef OUTPUT_SLAB_H
+#define OUTPUT_SLAB_H
+
+#include "tholder.h"
+
+// Number of task_output structs carved out of one heap allocation
+#define OUTPUT_SLAB_SIZE 64
+
+// A thread keeps at most this many free task_outputs, the rest go back to the shared list
+#define OUTPUT_CACHE_MAX 1024
+
+// Takes a task_output from this thread's free list, refilling it from the shared list or
+// a new slab only when it is empty
+task_output *output_slab_alloc();
+
+// Puts a task_output back on this thread's free list
+void output_slab_free(task_output *output);
+
+// Hands the calling thread's free list to the shared one. Called by workers on their way out, whose
+// lists would otherwise be lost with them
+void output_slab_thread_exit();
+
+// Frees every slab. Any task_output still in use becomes invalid
+void output_slab_destroy();
+
+#endif
@@ -0,0 +1,150 @@
+#include <errno.h>
+#include <stdlib.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+#include "task_queue.h"
+
+// Shared by every lane of one tholder_parallel_for() call. Lives on the caller's stack
+typedef struct parallel_for_data
+{
+    size_t begin;
+    size_t end;
+    size_t grain;
+    size_t lanes;
+    tholder_schedule schedule;
+    tholder_range_fn body;
+    void *ctx;
+
+    // Hands each lane its index, so lanes need no argument of their own
+    atomic_size_t next_lane;
+    // First iteration nobody has claimed yet, used by the dynamic and guided schedules
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t next;
+} parallel_for_data;
+
+static void run_static(parallel_for_data *pf, size_t lane)
+{
+    // Same split as cholesky_tholder_mod: the first `rem` lanes get one extra iteration
+    size_t total = pf->end - pf->begin;
+    size_t base = total / pf->lanes;
+    size_t rem = total % pf->lanes;
+    size_t start = pf->begin + lane * base + (lane < rem ? lane : rem);
+    size_t stop = start + base + (lane < rem ? 1 : 0);
+
+    if (start < stop)
+        pf->body(start, stop, pf->ctx);
+}
+
+static void run_dynamic(parallel_for_data *pf)
+{
+    while (true)
+    {
+        size_t start = atomic_fetch_add(&pf->next, pf->grain);
+        if (start >= pf->end)
+            return;
+
+        size_t stop = start + pf->grain < pf->end ? start + pf->grain : pf->end;
+        pf->body(start, stop, pf->ctx);
+    }
+}
+
+static void run_guided(parallel_for_data *pf)
+{
+    size_t start = atomic_load(&pf->next);
+
+    while (start < pf->end)
+    {
+        // Claim half of this lane's fair share of what is left
+        size_t chunk = (pf->end - start) / (2 * pf->lanes);
+        if (chunk < pf->grain)
+            chunk = pf->grain;
+        size_t stop = start + chunk < pf->end ? start + chunk : pf->end;
+
+        if (atomic_compare_exchange_weak(&pf->next, &start, stop))
+        {
+            pf->body(start, stop, pf->ctx);
+            start = atomic_load(&pf->next);
+        }
+    }
+}
+
+static void *parallel_for_lane(void *args)
+{
+    parallel_for_data *pf = (parallel_for_data *)args;
+    size_t lane = atomic_fetch_add(&pf->next_lane, 1);
+
+    switch (pf->schedule)
+    {
+    case THOLDER_STATIC:
+        run_static(pf, lane);
+        break;
+    case THOLDER_DYNAMIC:
+        run_dynamic(pf);
+        break;
+    case THOLDER_GUIDED:
+        run_guided(pf);
+        break;
+    }
+    return NULL;
+}
+
+int tholder_parallel_for(size_t begin, size_t end, size_t grain, tholder_schedule schedule,
+                         tholder_range_fn body, void *ctx)
+{
+    if (begin >= end)
+        return 0;
+
+    tholder_pool_t *pool = submit_pool();
+
+    if (grain == 0)
+        grain = 1;
+
+    // No point in having more lanes than chunks. Static blocks are split evenly, so only whole grains count there,
+    // or 10 iterations with a grain of 4 would end up as blocks of 3, 3 and 4
+    size_t chunks = schedule == THOLDER_STATIC ? (end - begin) / grain : (end - begin + grain - 1) / grain;
+    size_t lanes = pool->options.parallelism < chunks ? pool->options.parallelism : chunks;
+    if (lanes <= 1)
+    {
+        body(begin, end, ctx);
+        return 0;
+    }
+
+    parallel_for_data pf = {
+        .begin = begin,
+        .end = end,
+        .grain = grain,
+        .lanes = lanes,
+        .schedule = schedule,
+        .body = body,
+        .ctx = ctx,
+    };
+    atomic_init(&pf.next_lane, 0);
+    atomic_init(&pf.next, begin);
+
+    // The handles live on our stack and the task_outputs come from the free list,
+    // so no lane costs a malloc
+    tholder_t handles[lanes - 1];
+    size_t created = 0;
+    for (size_t i = 0; i < lanes - 1; i++)
+    {
+        // A lane the pool rejected is run here, lanes pick their index when they start
+        if (tholder_create(&handles[created], NULL, parallel_for_lane, &pf) == 0)
+            created++;
+        else
+            parallel_for_lane(&pf);
+    }
+
+    parallel_for_lane(&pf);
+
+    // Lanes inherit the caller's cancellation token, and a lane dropped by it never ran its share
+    int ret = 0;
+    for (size_t i = 0; i < created; i++)
+    {
+        void *result;
+        tholder_join(handles[i], &result);
+        if (result == THOLDER_CANCELLED)
+            ret = ECANCELED;
+    }
+
+    return ret;
+}
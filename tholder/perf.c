@@ -0,0 +1,239 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+typedef struct perf_entry
+{
+    void *(*fn)(void *);
+    unsigned long long tasks;
+    unsigned long long counts[PERF_COUNTERS];
+} perf_entry;
+
+// One worker slot's counters and totals. Only the worker in the slot writes it
+typedef struct perf_worker
+{
+    struct perf_worker *next;
+    // Group leader, -1 if no counter could be opened
+    int leader;
+    int fds[PERF_COUNTERS];
+    // Position of each counter in a group read, -1 if it is not open
+    int slot[PERF_COUNTERS];
+    int num_open;
+    // Counts of the current thread already charged to a task, taken off every read so an outer task
+    // only keeps what it did itself
+    unsigned long long charged[PERF_COUNTERS];
+    perf_entry table[PERF_TABLE_SIZE];
+} perf_worker;
+
+static const struct
+{
+    const char *name;
+    unsigned int type;
+    unsigned long long config;
+} counters[PERF_COUNTERS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"ctx switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+// Every worker ever started, so perf_report() can merge them
+static perf_worker *workers = NULL;
+static pthread_mutex_t perf_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local perf_worker *self = NULL;
+
+void perf_worker_start(struct perf_worker **slot)
+{
+    perf_worker *worker = *slot;
+    if (worker == NULL)
+    {
+        worker = (perf_worker *)calloc(1, sizeof(perf_worker));
+        if (worker == NULL)
+            return;
+
+        pthread_mutex_lock(&perf_lock);
+        worker->next = workers;
+        workers = worker;
+        pthread_mutex_unlock(&perf_lock);
+        *slot = worker;
+    }
+    // The new thread's counters start at 0
+    worker->leader = -1;
+    worker->num_open = 0;
+    memset(worker->charged, 0, sizeof(worker->charged));
+
+    for (int i = 0; i < PERF_COUNTERS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counters[i].type;
+        attr.config = counters[i].config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        // Hardware events count user space only, so they work with the default perf_event_paranoid. Context
+        // switches happen in the kernel and would always read 0 that way
+        if (counters[i].type == PERF_TYPE_HARDWARE)
+        {
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+        }
+
+        worker->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, worker->leader, 0);
+        worker->slot[i] = worker->fds[i] < 0 ? -1 : worker->num_open++;
+        if (worker->fds[i] >= 0 && worker->leader < 0)
+            worker->leader = worker->fds[i];
+    }
+
+    self = worker;
+}
+
+void perf_worker_stop()
+{
+    if (self == NULL)
+        return;
+
+    for (int i = 0; i < PERF_COUNTERS; i++)
+        if (self->fds[i] >= 0)
+            close(self->fds[i]);
+    self->leader = -1;
+    self = NULL;
+}
+
+void perf_read(unsigned long long snapshot[PERF_COUNTERS])
+{
+    // A group read returns the number of counters followed by their values, in the order they were opened
+    unsigned long long values[1 + PERF_COUNTERS] = {0};
+    if (self != NULL && self->leader >= 0)
+    {
+        if (read(self->leader, values, sizeof(values)) < 0)
+            values[0] = 0;
+    }
+
+    for (int i = 0; i < PERF_COUNTERS; i++)
+        snapshot[i] = self != NULL && self->slot[i] >= 0 ? values[1 + self->slot[i]] - self->charged[i] : 0;
+}
+
+void perf_task_done(void *(*fn)(void *), const unsigned long long snapshot[PERF_COUNTERS])
+{
+    if (self == NULL)
+        return;
+
+    unsigned long long now[PERF_COUNTERS];
+    perf_read(now);
+
+    // Open addressing on the function pointer. Functions past the table size are dropped
+    size_t hash = ((uintptr_t)fn >> 4) & (PERF_TABLE_SIZE - 1);
+    perf_entry *entry = NULL;
+    for (size_t probe = 0; probe < PERF_TABLE_SIZE && entry == NULL; probe++)
+    {
+        perf_entry *candidate = &self->table[(hash + probe) & (PERF_TABLE_SIZE - 1)];
+        if (candidate->fn == NULL || candidate->fn == fn)
+            entry = candidate;
+    }
+    if (entry != NULL)
+    {
+        entry->fn = fn;
+        entry->tasks++;
+    }
+
+    // Charged even when the task is dropped, a task that ran it while joining still did not do that work
+    for (int i = 0; i < PERF_COUNTERS; i++)
+    {
+        unsigned long long count = now[i] - snapshot[i];
+        if (entry != NULL)
+            entry->counts[i] += count;
+        self->charged[i] += count;
+    }
+}
+
+// Writes the symbol name of `fn` to `name`, or its address when dladdr() has no exact match for it
+static void function_name(void *(*fn)(void *), char *name, size_t size)
+{
+    Dl_info info;
+    void *address = (void *)(uintptr_t)fn;
+    if (dladdr(address, &info) != 0 && info.dli_sname != NULL && info.dli_saddr == address)
+        snprintf(name, size, "%s", info.dli_sname);
+    else
+        snprintf(name, size, "%p", address);
+}
+
+void perf_report()
+{
+    pthread_mutex_lock(&perf_lock);
+
+    // Merge the workers' tables by function
+    perf_entry totals[PERF_TABLE_SIZE * 4];
+    size_t num_totals = 0;
+    int available[PERF_COUNTERS] = {0};
+
+    for (perf_worker *worker = workers; worker != NULL; worker = worker->next)
+    {
+        for (int i = 0; i < PERF_COUNTERS; i++)
+            available[i] |= worker->slot[i] >= 0;
+
+        for (size_t e = 0; e < PERF_TABLE_SIZE; e++)
+        {
+            perf_entry *entry = &worker->table[e];
+            if (entry->fn == NULL)
+                continue;
+
+            size_t t = 0;
+            while (t < num_totals && totals[t].fn != entry->fn)
+                t++;
+            if (t == num_totals)
+            {
+                if (num_totals == sizeof(totals) / sizeof(totals[0]))
+                    continue;
+                memset(&totals[num_totals++], 0, sizeof(perf_entry));
+                totals[t].fn = entry->fn;
+            }
+
+            totals[t].tasks += entry->tasks;
+            for (int i = 0; i < PERF_COUNTERS; i++)
+                totals[t].counts[i] += entry->counts[i];
+        }
+    }
+
+    if (num_totals > 0)
+    {
+        fprintf(stderr, "%-24s %10s", "function", "tasks");
+        for (int i = 0; i < PERF_COUNTERS; i++)
+            fprintf(stderr, " %14s", counters[i].name);
+        fprintf(stderr, " %6s\n", "IPC");
+
+        for (size_t t = 0; t < num_totals; t++)
+        {
+            char name[64];
+            function_name(totals[t].fn, name, sizeof(name));
+            fprintf(stderr, "%-24s %10llu", name, totals[t].tasks);
+            for (int i = 0; i < PERF_COUNTERS; i++)
+            {
+                if (available[i])
+                    fprintf(stderr, " %14llu", totals[t].counts[i]);
+                else
+                    fprintf(stderr, " %14s", "n/a");
+            }
+
+            if (available[0] && available[1] && totals[t].counts[0] > 0)
+                fprintf(stderr, " %6.2f\n", (double)totals[t].counts[1] / totals[t].counts[0]);
+            else
+                fprintf(stderr, " %6s\n", "n/a");
+        }
+    }
+
+    // Kept, worker slots point at them. They start over for the next report
+    for (perf_worker *worker = workers; worker != NULL; worker = worker->next)
+        memset(worker->table, 0, sizeof(worker->table));
+
+    pthread_mutex_unlock(&perf_lock);
+}
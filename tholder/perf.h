@@ -0,0 +1,33 @@
+#ifndef PERF_H
+#define PERF_H
+
+// Hardware counters per task function. perf.c is only built with `make PERF=1`, which also
+// defines THOLDER_PERF to turn on the calls in tholder.c
+
+// Cycles, instructions, last-level cache misses and context switches
+#define PERF_COUNTERS 4
+
+// Distinct task functions each worker can attribute counts to, a power of two
+#define PERF_TABLE_SIZE 64
+
+struct perf_worker;
+
+// Opens the counters for the calling worker thread, which adds its counts to `*slot`, the totals of its
+// worker slot, allocated by the first worker in the slot. Counters the CPU or kernel does not support are
+// left out, the rest are read together as one group
+void perf_worker_start(struct perf_worker **slot);
+
+// Closes the calling worker's counters. Its counts are kept for perf_report()
+void perf_worker_stop();
+
+// Reads the calling worker's counters into `snapshot`, less what tasks already took, so a task that runs
+// others while it joins is not charged for them
+void perf_read(unsigned long long snapshot[PERF_COUNTERS]);
+
+// Attributes the counts since `snapshot` to `fn`
+void perf_task_done(void *(*fn)(void *), const unsigned long long snapshot[PERF_COUNTERS]);
+
+// Prints the counts summed per task function to stderr and clears them
+void perf_report();
+
+#endif
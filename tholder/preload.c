@@ -0,0 +1,303 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+
+// LD_PRELOAD shim that runs the threads of an unmodified pthread program as tasks on the default pool.
+// Only part of the shared build, `make preload`
+
+// Set on every handle pthread_create() returns for a task, so pthread_join() and pthread_detach() can tell
+// them apart from real threads. Both our structs and glibc's thread descriptors are at least 8-byte aligned
+#define TASK_TAG 1UL
+
+// A pthread_create() that became a task. Its tagged address is the task's pthread_t
+typedef struct preload_thread
+{
+    void *(*start_routine)(void *);
+    void *arg;
+    tholder_t task;
+    // Set by whichever of the task's end and pthread_detach() comes first. The second one frees the struct
+    atomic_bool released;
+} preload_thread;
+
+typedef int (*create_fn)(pthread_t *, const pthread_attr_t *, void *(*)(void *), void *);
+typedef int (*join_fn)(pthread_t, void **);
+typedef int (*detach_fn)(pthread_t);
+typedef pthread_t (*self_fn)();
+typedef void (*exit_fn)(void *);
+typedef void (*cancel_buf_fn)(__pthread_unwind_buf_t *);
+
+// libc's versions, looked up on first use
+static create_fn next_create;
+static join_fn next_join;
+static detach_fn next_detach;
+static self_fn next_self;
+static exit_fn next_exit;
+static cancel_buf_fn next_register, next_register_defer, next_unregister, next_unregister_restore, next_unwind_next;
+static pthread_once_t resolved = PTHREAD_ONCE_INIT;
+
+// The task running on this thread, or 0 outside tasks started through pthread_create()
+static _Thread_local preload_thread *current_thread = NULL;
+// Where pthread_exit() jumps to in that task, and the value it leaves
+static _Thread_local jmp_buf *exit_point = NULL;
+static _Thread_local void *exit_value;
+// Innermost pthread_cleanup_push() of that task. Each buffer links to the one pushed before it through its
+// first padding word, which libc only uses for buffers it registered itself
+static _Thread_local __pthread_unwind_buf_t *cleanup_top = NULL;
+
+// Assigned through a void * as POSIX suggests, ISO C has no cast from object to function pointers
+static void resolve()
+{
+    *(void **)&next_create = dlsym(RTLD_NEXT, "pthread_create");
+    *(void **)&next_join = dlsym(RTLD_NEXT, "pthread_join");
+    *(void **)&next_detach = dlsym(RTLD_NEXT, "pthread_detach");
+    *(void **)&next_self = dlsym(RTLD_NEXT, "pthread_self");
+    *(void **)&next_exit = dlsym(RTLD_NEXT, "pthread_exit");
+    *(void **)&next_register = dlsym(RTLD_NEXT, "__pthread_register_cancel");
+    *(void **)&next_register_defer = dlsym(RTLD_NEXT, "__pthread_register_cancel_defer");
+    *(void **)&next_unregister = dlsym(RTLD_NEXT, "__pthread_unregister_cancel");
+    *(void **)&next_unregister_restore = dlsym(RTLD_NEXT, "__pthread_unregister_cancel_restore");
+    *(void **)&next_unwind_next = dlsym(RTLD_NEXT, "__pthread_unwind_next");
+}
+
+int real_pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg)
+{
+    pthread_once(&resolved, resolve);
+    return next_create(thread, attr, start_routine, arg);
+}
+
+int real_pthread_join(pthread_t thread, void **retval)
+{
+    pthread_once(&resolved, resolve);
+    return next_join(thread, retval);
+}
+
+int real_pthread_detach(pthread_t thread)
+{
+    pthread_once(&resolved, resolve);
+    return next_detach(thread);
+}
+
+pthread_t real_pthread_self()
+{
+    pthread_once(&resolved, resolve);
+    return next_self();
+}
+
+static void release(preload_thread *t)
+{
+    if (atomic_exchange(&t->released, true))
+        free(t);
+}
+
+static void *preload_task(void *args)
+{
+    preload_thread *t = (preload_thread *)args;
+
+    // A pthread_create() that finds the queue full may still run one task inside another
+    preload_thread *outer_thread = current_thread;
+    jmp_buf *outer_exit = exit_point;
+    __pthread_unwind_buf_t *outer_cleanup = cleanup_top;
+    jmp_buf here;
+    void *result;
+
+    // The body may block on anything a thread can, like a condition variable, so the worker stops counting toward
+    // the pool's limits while it runs, and the next pthread_create() gets another worker
+    blocking_task_begin();
+    current_thread = t;
+    exit_point = &here;
+    cleanup_top = NULL;
+    if (setjmp(here) == 0)
+        result = t->start_routine(t->arg);
+    else
+        result = exit_value;
+    current_thread = outer_thread;
+    exit_point = outer_exit;
+    cleanup_top = outer_cleanup;
+    blocking_end();
+
+    release(t);
+    return result;
+}
+
+// Workers run on default-sized stacks, so a thread that asks for a bigger one gets a real thread
+static bool needs_own_stack(const pthread_attr_t *attr)
+{
+    size_t wanted, standard;
+    pthread_attr_t defaults;
+    if (pthread_attr_getstacksize(attr, &wanted) != 0 || pthread_getattr_default_np(&defaults) != 0)
+        return false;
+    pthread_attr_getstacksize(&defaults, &standard);
+    pthread_attr_destroy(&defaults);
+    return wanted > standard;
+}
+
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg)
+{
+    int detach_state = PTHREAD_CREATE_JOINABLE;
+    if (attr != NULL)
+    {
+        if (needs_own_stack(attr))
+            return real_pthread_create(thread, attr, start_routine, arg);
+        pthread_attr_getdetachstate(attr, &detach_state);
+    }
+
+    preload_thread *t = (preload_thread *)malloc(sizeof(preload_thread));
+    if (t == NULL)
+        return EAGAIN;
+    t->start_routine = start_routine;
+    t->arg = arg;
+    atomic_init(&t->released, false);
+
+    int ret = tholder_create(&t->task, NULL, preload_task, t);
+    if (ret != 0)
+    {
+        free(t);
+        return ret;
+    }
+    *thread = (pthread_t)t | TASK_TAG;
+
+    if (detach_state == PTHREAD_CREATE_DETACHED)
+        pthread_detach(*thread);
+    return 0;
+}
+
+int pthread_join(pthread_t thread, void **retval)
+{
+    if (!(thread & TASK_TAG))
+        return real_pthread_join(thread, retval);
+
+    preload_thread *t = (preload_thread *)(thread & ~TASK_TAG);
+    if (t == current_thread)
+        return EDEADLK;
+
+    // Sleep until the task is done instead of helping like tholder_join() does. A thread body run here would
+    // share this thread's stack, id and thread-locals, and could wait for something we only do after the join
+    task_output *output = (task_output *)t->task;
+    unsigned int state = OUTPUT_PENDING;
+    if (atomic_compare_exchange_strong(&output->state, &state, OUTPUT_WAITED) || state == OUTPUT_WAITED)
+    {
+        while (atomic_load(&output->state) != OUTPUT_DONE)
+            futex_wait(&output->state, OUTPUT_WAITED, -1);
+    }
+
+    // Done by now, so this only collects the result
+    int ret = tholder_join(t->task, retval);
+    free(t);
+    return ret;
+}
+
+int pthread_detach(pthread_t thread)
+{
+    if (!(thread & TASK_TAG))
+        return real_pthread_detach(thread);
+
+    preload_thread *t = (preload_thread *)(thread & ~TASK_TAG);
+    tholder_detach(t->task);
+    release(t);
+    return 0;
+}
+
+// Inside a task this is the handle pthread_create() returned for it, so comparing the two with pthread_equal()
+// works as it does with real threads
+pthread_t pthread_self()
+{
+    if (current_thread != NULL)
+        return (pthread_t)current_thread | TASK_TAG;
+    return real_pthread_self();
+}
+
+// Leaves the current task through its innermost cleanup handler, or its end once none are left. A handler's
+// buffer was filled by the setjmp in pthread_cleanup_push(), which runs the handler and calls
+// __pthread_unwind_next() for the one before it
+static __attribute__((noreturn)) void unwind_task()
+{
+    __pthread_unwind_buf_t *buf = cleanup_top;
+    if (buf == NULL)
+        longjmp(*exit_point, 1);
+    cleanup_top = (__pthread_unwind_buf_t *)buf->__pad[0];
+    // The buffer is shorter than a jmp_buf, it leaves out the signal mask, which setjmp did not save
+    struct __jmp_buf_tag *handler = (struct __jmp_buf_tag *)(void *)buf;
+    longjmp(handler, 1);
+}
+
+// Inside a task this ends the task instead of the worker running it, after running its cleanup handlers
+void pthread_exit(void *retval)
+{
+    if (exit_point != NULL)
+    {
+        exit_value = retval;
+        unwind_task();
+    }
+
+    pthread_once(&resolved, resolve);
+    next_exit(retval);
+    abort();
+}
+
+// pthread_cleanup_push() and pthread_cleanup_pop() of C code come down to these. Inside a task the handlers are kept
+// on the task's own list, libc's list belongs to the worker and its pthread_exit() would end the worker
+static void push_cleanup(__pthread_unwind_buf_t *buf)
+{
+    buf->__pad[0] = cleanup_top;
+    cleanup_top = buf;
+}
+
+void __pthread_register_cancel(__pthread_unwind_buf_t *buf)
+{
+    if (exit_point != NULL)
+    {
+        push_cleanup(buf);
+        return;
+    }
+    pthread_once(&resolved, resolve);
+    next_register(buf);
+}
+
+void __pthread_register_cancel_defer(__pthread_unwind_buf_t *buf)
+{
+    if (exit_point != NULL)
+    {
+        push_cleanup(buf);
+        return;
+    }
+    pthread_once(&resolved, resolve);
+    next_register_defer(buf);
+}
+
+void __pthread_unregister_cancel(__pthread_unwind_buf_t *buf)
+{
+    if (exit_point != NULL)
+    {
+        cleanup_top = (__pthread_unwind_buf_t *)buf->__pad[0];
+        return;
+    }
+    pthread_once(&resolved, resolve);
+    next_unregister(buf);
+}
+
+void __pthread_unregister_cancel_restore(__pthread_unwind_buf_t *buf)
+{
+    if (exit_point != NULL)
+    {
+        cleanup_top = (__pthread_unwind_buf_t *)buf->__pad[0];
+        return;
+    }
+    pthread_once(&resolved, resolve);
+    next_unregister_restore(buf);
+}
+
+// Called by a handler pthread_exit() ran, to go on with the next one
+void __pthread_unwind_next(__pthread_unwind_buf_t *buf)
+{
+    if (exit_point != NULL)
+        unwind_task();
+    pthread_once(&resolved, resolve);
+    next_unwind_next(buf);
+    abort();
+}
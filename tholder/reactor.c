@@ -0,0 +1,274 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+
+// Events one reactor takes from the kernel per epoll_wait()
+#define REACTOR_EVENTS 64
+// How long a reactor waits before it offers rejected tasks to the pool again
+#define REACTOR_RETRY_MS 1
+
+// A task waiting for its fd, from tholder_pool_submit_on_readable() until it is queued on the pool
+typedef struct reactor_registration
+{
+    int fd;
+    void *(*function)(void *);
+    void *args;
+    // Neighbours in the reactor's list, which is only there so the pool can free what never became ready
+    struct reactor_registration *prev;
+    struct reactor_registration *next;
+    // Next in the reactor's retry list, while the pool's queue is too full to take the task
+    struct reactor_registration *retry_next;
+} reactor_registration;
+
+// One epoll instance and the thread that waits on it. An fd always goes to the same reactor
+struct reactor
+{
+    tholder_pool_t *pool;
+    int epoll_fd;
+    pthread_t thread;
+    // Guards `registrations`, the epoll calls need no lock
+    pthread_mutex_t lock;
+    reactor_registration *registrations;
+    // Ready registrations the pool rejected, oldest first. Only the reactor thread touches them
+    reactor_registration *retry_head;
+    reactor_registration *retry_tail;
+};
+
+static void link_registration(struct reactor *r, reactor_registration *reg)
+{
+    pthread_mutex_lock(&r->lock);
+    reg->prev = NULL;
+    reg->next = r->registrations;
+    if (r->registrations != NULL)
+        r->registrations->prev = reg;
+    r->registrations = reg;
+    pthread_mutex_unlock(&r->lock);
+}
+
+static void unlink_registration(struct reactor *r, reactor_registration *reg)
+{
+    pthread_mutex_lock(&r->lock);
+    if (reg->prev != NULL)
+        reg->prev->next = reg->next;
+    else
+        r->registrations = reg->next;
+    if (reg->next != NULL)
+        reg->next->prev = reg->prev;
+    pthread_mutex_unlock(&r->lock);
+}
+
+// Starts watching `reg->fd`. Returns 0 or the errno of epoll_ctl()
+static int arm(struct reactor *r, reactor_registration *reg)
+{
+    // Linked first, the event can arrive before epoll_ctl() returns
+    link_registration(r, reg);
+
+    struct epoll_event event = {.events = EPOLLIN | EPOLLRDHUP, .data.ptr = reg};
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, reg->fd, &event) != 0)
+    {
+        int error = errno;
+        unlink_registration(r, reg);
+        return error;
+    }
+    return 0;
+}
+
+// Queues the task of a ready registration and frees it. Returns false if the pool's queue rejected it
+static bool queue_task(struct reactor *r, reactor_registration *reg)
+{
+    tholder_pool_t *pool = r->pool;
+
+    task t = {reg->function, reg->args, NULL, NULL};
+    if (submit_task_to(pool, &t, NULL, -1, THOLDER_PRIORITY_NORMAL) != 0)
+        return false;
+
+    unlink_registration(r, reg);
+    atomic_fetch_add(&pool->fd_dispatches, 1);
+    atomic_fetch_sub(&pool->fds_waiting, 1);
+    free(reg);
+    return true;
+}
+
+// Queues the task of a registration whose fd became readable
+static void dispatch(struct reactor *r, reactor_registration *reg)
+{
+    // Removed before the task can run, so it may close the fd or wait on it again
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, reg->fd, NULL);
+
+    // Behind older rejected tasks, or rejected by a full queue itself. Watching the still readable fd again
+    // would wake the reactor right away, so it waits on the retry list instead
+    if (r->retry_head != NULL || !queue_task(r, reg))
+    {
+        reg->retry_next = NULL;
+        if (r->retry_tail != NULL)
+            r->retry_tail->retry_next = reg;
+        else
+            r->retry_head = reg;
+        r->retry_tail = reg;
+    }
+}
+
+// Offers the rejected tasks to the pool again, in order, until the queue is full
+static void retry_rejected(struct reactor *r)
+{
+    while (r->retry_head != NULL)
+    {
+        reactor_registration *reg = r->retry_head;
+        reactor_registration *next = reg->retry_next;
+        if (!queue_task(r, reg))
+            return;
+        r->retry_head = next;
+        if (next == NULL)
+            r->retry_tail = NULL;
+    }
+}
+
+static void *reactor_loop(void *args)
+{
+    struct reactor *r = (struct reactor *)args;
+    struct epoll_event events[REACTOR_EVENTS];
+
+    bool stop = false;
+    while (!stop)
+    {
+        // While tasks wait for room in the queue the reactor also wakes up every millisecond to retry them,
+        // so a full queue costs a wake-up per millisecond instead of a busy loop
+        int n = epoll_wait(r->epoll_fd, events, REACTOR_EVENTS, r->retry_head != NULL ? REACTOR_RETRY_MS : -1);
+        retry_rejected(r);
+        for (int i = 0; i < n; i++)
+        {
+            // Only the stop eventfd has no registration
+            if (events[i].data.ptr == NULL)
+                stop = true;
+            else
+                dispatch(r, (reactor_registration *)events[i].data.ptr);
+        }
+    }
+    return NULL;
+}
+
+// Starts the reactors of `pool` unless they are running. Returns 0 or an errno value
+static int reactor_start(tholder_pool_t *pool)
+{
+    int error = 0;
+    pthread_mutex_lock(&pool->lock);
+    if (atomic_load(&pool->reactor_running))
+        goto out;
+    // A task that is drained during shutdown gets no new reactor
+    if (atomic_load(&pool->shutting_down))
+    {
+        error = EAGAIN;
+        goto out;
+    }
+
+    size_t count = pool->options.reactor_threads > 0 ? pool->options.reactor_threads : DEFAULT_REACTOR_THREADS;
+    pool->reactors = (struct reactor *)calloc(count, sizeof(struct reactor));
+    if (pool->reactors == NULL)
+    {
+        error = ENOMEM;
+        goto out;
+    }
+    // Level-triggered and never read, so once written it wakes every reactor
+    pool->reactor_stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (pool->reactor_stop_fd < 0)
+        exit(EXIT_FAILURE);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        struct reactor *r = &pool->reactors[i];
+        r->pool = pool;
+        r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (r->epoll_fd < 0)
+            exit(EXIT_FAILURE);
+        pthread_mutex_init(&r->lock, NULL);
+        r->registrations = NULL;
+        r->retry_head = NULL;
+        r->retry_tail = NULL;
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+        epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, pool->reactor_stop_fd, &event);
+        if (real_pthread_create(&r->thread, NULL, reactor_loop, r) != 0)
+            exit(EXIT_FAILURE);
+    }
+    pool->num_reactors = count;
+    atomic_store(&pool->reactor_running, true);
+
+out:
+    pthread_mutex_unlock(&pool->lock);
+    return error;
+}
+
+int tholder_pool_submit_on_readable(tholder_pool_t *pool, int fd, void *(*fn)(void *), void *arg)
+{
+    if (!atomic_load(&pool->reactor_running))
+    {
+        int error = reactor_start(pool);
+        if (error != 0)
+            return error;
+    }
+
+    reactor_registration *reg = (reactor_registration *)malloc(sizeof(reactor_registration));
+    if (reg == NULL)
+        return ENOMEM;
+    reg->fd = fd;
+    reg->function = fn;
+    reg->args = arg;
+
+    // Counted before the fd is watched, the reactor uncounts it once it is ready
+    atomic_fetch_add(&pool->fds_waiting, 1);
+    int error = arm(&pool->reactors[(size_t)fd % pool->num_reactors], reg);
+    if (error != 0)
+    {
+        atomic_fetch_sub(&pool->fds_waiting, 1);
+        free(reg);
+    }
+    return error;
+}
+
+int tholder_submit_on_readable(int fd, void *(*fn)(void *), void *arg)
+{
+    return tholder_pool_submit_on_readable(submit_pool(), fd, fn, arg);
+}
+
+void reactor_stop(tholder_pool_t *pool)
+{
+    if (!atomic_load(&pool->reactor_running))
+        return;
+
+    uint64_t one = 1;
+    if (write(pool->reactor_stop_fd, &one, sizeof(one)) != sizeof(one))
+        exit(EXIT_FAILURE);
+    for (size_t i = 0; i < pool->num_reactors; i++)
+        real_pthread_join(pool->reactors[i].thread, NULL);
+}
+
+void reactor_destroy(tholder_pool_t *pool)
+{
+    if (pool->reactors == NULL)
+        return;
+
+    for (size_t i = 0; i < pool->num_reactors; i++)
+    {
+        struct reactor *r = &pool->reactors[i];
+        while (r->registrations != NULL)
+        {
+            reactor_registration *reg = r->registrations;
+            r->registrations = reg->next;
+            free(reg);
+        }
+        close(r->epoll_fd);
+        pthread_mutex_destroy(&r->lock);
+    }
+    close(pool->reactor_stop_fd);
+    free(pool->reactors);
+    pool->reactors = NULL;
+    pool->num_reactors = 0;
+    atomic_store(&pool->fds_waiting, 0);
+    atomic_store(&pool->reactor_running, false);
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+
+void tholder_stats(tholder_stats_t *stats)
+{
+    tholder_pool_stats(current_pool(), stats);
+}
+
+void tholder_pool_stats(tholder_pool_t *pool, tholder_stats_t *stats)
+{
+    *stats = (tholder_stats_t){0};
+    stats->live_workers = atomic_load(&pool->live_threads);
+    stats->threads_spawned = atomic_load(&pool->threads_spawned);
+    stats->tasks_run_outside = atomic_load(&pool->tasks_run_outside);
+    stats->target_workers = atomic_load(&pool->target_workers);
+    stats->utilization = atomic_load(&pool->utilization);
+    stats->elastic_grows = atomic_load(&pool->elastic_grows);
+    stats->elastic_shrinks = atomic_load(&pool->elastic_shrinks);
+    stats->fibers = pool->options.fibers ? atomic_load(&pool->fibers_allocated) : 0;
+    stats->fds_waiting = atomic_load(&pool->fds_waiting);
+    stats->fd_dispatches = atomic_load(&pool->fd_dispatches);
+    stats->timers_pending = atomic_load(&pool->timers_pending);
+    stats->timers_fired = atomic_load(&pool->timers_fired);
+    stats->tasks_cancelled = atomic_load(&pool->tasks_cancelled);
+
+    // Slots are never freed before the pool shuts down, so they can be read without a lock
+    size_t size = atomic_load(&pool->size);
+    for (size_t i = 0; i < size; i++)
+    {
+        thread_data *td = pool_get(pool, i);
+        if (td == NULL)
+            continue;
+
+        stats->workers++;
+        stats->tasks_run += atomic_load_explicit(&td->stats.tasks_run, memory_order_relaxed);
+        stats->busy_ns += atomic_load_explicit(&td->stats.busy_ns, memory_order_relaxed);
+        stats->idle_ns += atomic_load_explicit(&td->stats.idle_ns, memory_order_relaxed);
+        stats->queue_wait_ns += atomic_load_explicit(&td->stats.queue_wait_ns, memory_order_relaxed);
+        stats->signal_wakeups += atomic_load_explicit(&td->stats.signal_wakeups, memory_order_relaxed);
+        stats->timeout_wakeups += atomic_load_explicit(&td->stats.timeout_wakeups, memory_order_relaxed);
+        stats->respawns += atomic_load_explicit(&td->stats.respawns, memory_order_relaxed);
+    }
+}
+
+void stats_dump(tholder_pool_t *pool)
+{
+    fprintf(stderr, "%8s %10s %12s %12s %14s %8s %8s %9s\n", "worker", "tasks", "busy ms", "idle ms",
+            "queue wait ms", "signal", "timeout", "respawns");
+
+    size_t size = atomic_load(&pool->size);
+    for (size_t i = 0; i < size; i++)
+    {
+        thread_data *td = pool_get(pool, i);
+        if (td == NULL)
+            continue;
+
+        fprintf(stderr, "%8zu %10llu %12.3f %12.3f %14.3f %8llu %8llu %9llu\n", td->index,
+                atomic_load(&td->stats.tasks_run), atomic_load(&td->stats.busy_ns) / 1e6,
+                atomic_load(&td->stats.idle_ns) / 1e6, atomic_load(&td->stats.queue_wait_ns) / 1e6,
+                atomic_load(&td->stats.signal_wakeups), atomic_load(&td->stats.timeout_wakeups),
+                atomic_load(&td->stats.respawns));
+    }
+
+    tholder_stats_t stats;
+    tholder_pool_stats(pool, &stats);
+    fprintf(stderr, "%8s %10llu %12.3f %12.3f %14.3f %8llu %8llu %9llu\n", "total", stats.tasks_run,
+            stats.busy_ns / 1e6, stats.idle_ns / 1e6, stats.queue_wait_ns / 1e6, stats.signal_wakeups,
+            stats.timeout_wakeups, stats.respawns);
+    fprintf(stderr, "%zu workers spawned, %llu tasks run outside the pool\n", stats.threads_spawned,
+            stats.tasks_run_outside);
+    if (pool->options.elastic)
+        fprintf(stderr, "elastic: target %zu workers at %u%% utilization, grown %llu times, shrunk %llu times\n",
+                stats.target_workers, stats.utilization, stats.elastic_grows, stats.elastic_shrinks);
+}
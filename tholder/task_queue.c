@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "task_queue.h"
+
+void task_queue_init(task_queue *q, size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    q->cells = (task_cell *)calloc(size, sizeof(task_cell));
+    if (q->cells == NULL)
+        exit(EXIT_FAILURE);
+
+    // Cell i is free for the producer holding ticket i
+    for (size_t i = 0; i < size; i++)
+        atomic_init(&q->cells[i].sequence, i);
+
+    q->mask = size - 1;
+    atomic_init(&q->enqueue_pos, 0);
+    atomic_init(&q->dequeue_pos, 0);
+}
+
+void task_queue_destroy(task_queue *q)
+{
+    free(q->cells);
+    q->cells = NULL;
+}
+
+bool task_queue_push(task_queue *q, const task *t)
+{
+    task_cell *cell;
+    size_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+
+    while (true)
+    {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            // The cell is free, try to claim this ticket
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // The consumer one lap behind has not emptied this cell yet
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    cell->data = *t;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+bool task_queue_pop(task_queue *q, task *t)
+{
+    task_cell *cell;
+    size_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+
+    while (true)
+    {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // Nothing has been published at this ticket yet
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+        }
+    }
+
+    *t = cell->data;
+    // Hand the cell to the producer one lap ahead
+    atomic_store_explicit(&cell->sequence, pos + q->mask + 1, memory_order_release);
+    return true;
+}
+
+size_t task_queue_size(task_queue *q)
+{
+    size_t enqueued = atomic_load(&q->enqueue_pos);
+    size_t dequeued = atomic_load(&q->dequeue_pos);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+bool task_queue_empty(task_queue *q)
+{
+    size_t pos = atomic_load(&q->dequeue_pos);
+    size_t seq = atomic_load(&q->cells[pos & q->mask].sequence);
+    return (intptr_t)seq - (intptr_t)(pos + 1) < 0;
+}
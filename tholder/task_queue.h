@@ -0,0 +1,64 @@
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "tholder.h"
+
+#define CACHE_LINE_SIZE 64
+
+// A unit of work waiting to be picked up by a worker
+typedef struct task
+{
+    void *(*function)(void *);
+    void *args;
+    // At most one of these is set: where tholder_join() finds the result, or the group to count down.
+    // Neither is set for detached tasks
+    task_output *output;
+    tholder_group_t *group;
+    // Token that drops the task if it is cancelled before the task starts, NULL if it cannot be
+    tholder_cancel_t *cancel;
+    // When the task was submitted, only set with the `collect_stats` option
+    unsigned long long submit_ns;
+    // Only set when tracing, see trace.h
+    unsigned long long trace_id;
+} task;
+
+// One slot of the ring. `sequence` tells producers and consumers whose turn it is
+typedef struct task_cell
+{
+    atomic_size_t sequence;
+    task data;
+} task_cell;
+
+// Bounded lock-free multi-producer/multi-consumer ring queue (Vyukov style).
+// Both push and pop are O(1) and never take a lock.
+typedef struct task_queue
+{
+    task_cell *cells;
+    size_t mask;
+
+    // Producers and consumers each get their own cache line
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_pos;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_pos;
+} task_queue;
+
+// `capacity` is rounded up to the next power of two
+void task_queue_init(task_queue *q, size_t capacity);
+
+void task_queue_destroy(task_queue *q);
+
+// Returns false if the queue is full
+bool task_queue_push(task_queue *q, const task *t);
+
+// Returns false if the queue is empty
+bool task_queue_pop(task_queue *q, task *t);
+
+bool task_queue_empty(task_queue *q);
+
+// Number of tasks queued, only a snapshot while other threads push and pop
+size_t task_queue_size(task_queue *q);
+
+#endif
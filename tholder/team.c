@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+#include "task_queue.h"
+#include "futex.h"
+
+struct tholder_team
+{
+    size_t members;
+    pthread_t *threads;
+    unsigned int spin_iterations;
+
+    // Phase to run next, written by member 0 before it releases the start barrier
+    tholder_phase_fn fn;
+    void *ctx;
+    bool stopping;
+
+    // Members that reached the current barrier
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t arrived;
+    // Flipped by the last member to arrive. Doubles as the futex word
+    _Alignas(CACHE_LINE_SIZE) atomic_uint sense;
+    // Members asleep on `sense`, so the last one only calls futex_wake when needed
+    atomic_uint sleepers;
+};
+
+// Sense-reversing barrier. The sense cannot flip before we arrive, so reading it on the way in
+// tells us which value releases us, and no member needs state of its own
+void tholder_team_barrier(tholder_team_t *team)
+{
+    unsigned int sense = atomic_load(&team->sense);
+
+    if (atomic_fetch_add(&team->arrived, 1) == team->members - 1)
+    {
+        atomic_store(&team->arrived, 0);
+        atomic_store(&team->sense, !sense);
+        if (atomic_load(&team->sleepers) > 0)
+            futex_wake(&team->sense, INT_MAX);
+        return;
+    }
+
+    // Phases are usually short and balanced, so spin before sleeping
+    for (unsigned int i = 0; i < team->spin_iterations; i++)
+    {
+        if (atomic_load(&team->sense) != sense)
+            return;
+        cpu_relax();
+    }
+
+    atomic_fetch_add(&team->sleepers, 1);
+    while (atomic_load(&team->sense) == sense)
+        futex_wait(&team->sense, sense, -1);
+    atomic_fetch_sub(&team->sleepers, 1);
+}
+
+typedef struct team_member
+{
+    tholder_team_t *team;
+    size_t index;
+} team_member;
+
+static void *team_member_loop(void *args)
+{
+    team_member member = *(team_member *)args;
+    free(args);
+    tholder_team_t *team = member.team;
+
+    while (true)
+    {
+        // Start barrier: released by member 0 once it has published the next phase
+        tholder_team_barrier(team);
+        if (team->stopping)
+            break;
+
+        team->fn(team, member.index, team->ctx);
+
+        // End barrier: tholder_team_run() returns once everybody is through it
+        tholder_team_barrier(team);
+    }
+    return NULL;
+}
+
+tholder_team_t *tholder_team_create(size_t members)
+{
+    if (members == 0)
+        return NULL;
+
+    tholder_team_t *team = (tholder_team_t *)aligned_alloc(CACHE_LINE_SIZE, sizeof(tholder_team_t));
+    if (team == NULL)
+        return NULL;
+
+    team->members = members;
+    tholder_pool_t *pool = current_pool();
+    team->spin_iterations = atomic_load(&pool->initialized) ? pool->options.spin_iterations : DEFAULT_SPIN_ITERATIONS;
+    team->fn = NULL;
+    team->ctx = NULL;
+    team->stopping = false;
+    atomic_init(&team->arrived, 0);
+    atomic_init(&team->sense, 0);
+    atomic_init(&team->sleepers, 0);
+
+    team->threads = (pthread_t *)malloc(members * sizeof(pthread_t));
+    if (team->threads == NULL)
+    {
+        free(team);
+        return NULL;
+    }
+
+    for (size_t i = 1; i < members; i++)
+    {
+        team_member *member = (team_member *)malloc(sizeof(team_member));
+        if (member != NULL)
+        {
+            member->team = team;
+            member->index = i;
+        }
+
+        if (member == NULL || real_pthread_create(&team->threads[i], NULL, team_member_loop, member) != 0)
+        {
+            free(member);
+            // Shrink the team to the threads we have and shut them down
+            team->members = i;
+            tholder_team_destroy(team);
+            return NULL;
+        }
+    }
+
+    return team;
+}
+
+size_t tholder_team_size(const tholder_team_t *team)
+{
+    return team->members;
+}
+
+void tholder_team_run(tholder_team_t *team, tholder_phase_fn fn, void *ctx)
+{
+    team->fn = fn;
+    team->ctx = ctx;
+
+    tholder_team_barrier(team);
+    fn(team, 0, ctx);
+    tholder_team_barrier(team);
+}
+
+void tholder_team_destroy(tholder_team_t *team)
+{
+    team->stopping = true;
+    tholder_team_barrier(team);
+
+    for (size_t i = 1; i < team->members; i++)
+        real_pthread_join(team->threads[i], NULL);
+
+    free(team->threads);
+    free(team);
+}
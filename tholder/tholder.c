@@ -2,21 +2,48 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdint-gcc.h>
- 
+
 #include <sys/time.h>
 #include <time.h>
 #include <string.h>
+#include <sched.h>
+#include <limits.h>
 #include "errno.h"
 
 #include "tholder.h"
+#include "tholder_internal.h"
+#include "task_queue.h"
+#include "work_deque.h"
+#include "futex.h"
+#include "output_slab.h"
+#include "trace.h"
+#include "perf.h"
+#include "affinity.h"
+#include "fiber.h"
 #include "pthread.h"
 
 
 /* LIBRARY GLOBAL VARIABLES */
-size_t threads_spawned = 0;
-pthread_mutex_t thread_pool_lock = PTHREAD_MUTEX_INITIALIZER;
-thread_data **thread_pool = NULL;
-size_t thread_pool_size = 0;
+// Workers spawned by every pool together
+atomic_size_t threads_spawned = 0;
+
+// What the global functions work on. Initialized by tholder_init_opts(), or on first use
+tholder_pool_t default_pool = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// Pools that are initialized. The task_output slabs are shared, so they are only freed with the last one
+static atomic_size_t active_pools = 0;
+static atomic_size_t next_pool_id = 1;
+
+// The slot of the worker running on this thread, NULL for threads outside every pool
+static _Thread_local thread_data *current_worker = NULL;
+// Pool of the task running on this thread, which may differ from the worker's own while it helps in a join
+static _Thread_local tholder_pool_t *running_pool = NULL;
+// Cancellation token of the task running on this thread, which the tasks it creates inherit
+static _Thread_local tholder_cancel_t *running_cancel = NULL;
+// Victim picker for threads outside the pool that steal while they wait in a join
+static _Thread_local unsigned int helper_rng = 1;
+// Counts this thread's looks for work since the background lane last went first
+static _Thread_local unsigned int background_turn = 0;
 
 
 int dbg(const char *format, ...)
@@ -26,236 +53,1061 @@ int dbg(const char *format, ...)
         va_start(args, format);
         return vprintf(format, args);
     }
-    
+
     return 0;
 }
 
-// finds a slot with no task to run
-thread_data *get_inactive_index()
+tholder_pool_t *current_pool()
 {
-    size_t index = 0;
+    if (running_pool != NULL)
+        return running_pool;
+    return current_worker != NULL ? current_worker->pool : &default_pool;
+}
 
-    // If the region is not initialized, init with DEFAULT_MAX_THREADS
-    // This first if statement is meant to protect threads from unnecessary lock contention
-    if (thread_pool == NULL)
-    {
+tholder_cancel_t *current_cancel()
+{
+    return running_cancel;
+}
+
+tholder_pool_t *submit_pool()
+{
+    tholder_pool_t *pool = current_pool();
+    // If the library is not initialized, init with DEFAULT_MAX_THREADS
+    if (!atomic_load(&pool->initialized))
         tholder_init(DEFAULT_MAX_THREADS);
+    return pool;
+}
+
+// The worker running on this thread, for code that may have moved to another thread since it last
+// looked, see run_task(). Inlined, the compiler could keep using the previous thread's address
+static __attribute__((noinline)) thread_data *this_thread_worker()
+{
+    return current_worker;
+}
+
+// The calling thread's worker if it belongs to `pool`. Workers of other pools help like outside threads
+static thread_data *worker_of(tholder_pool_t *pool)
+{
+    thread_data *self = current_worker;
+    return self != NULL && self->pool == pool ? self : NULL;
+}
+
+// Returns slot `index`, or NULL if its segment does not exist. With `create`, a missing segment is
+// allocated and installed with a CAS, and whoever loses the race frees theirs
+static pool_slot *pool_slot_at(tholder_pool_t *pool, size_t index, bool create)
+{
+    size_t segment_index = index / POOL_SEGMENT_SIZE;
+    if (segment_index >= POOL_MAX_SEGMENTS)
+        return NULL;
+
+    pool_slot *segment = atomic_load_explicit(&pool->slots[segment_index], memory_order_acquire);
+    if (segment == NULL && create)
+    {
+        pool_slot *fresh = (pool_slot *)calloc(POOL_SEGMENT_SIZE, sizeof(pool_slot));
+        if (fresh == NULL)
+            exit(EXIT_FAILURE);
+
+        if (atomic_compare_exchange_strong(&pool->slots[segment_index], &segment, fresh))
+        {
+            segment = fresh;
+            dbg("Added thread pool segment %zu\n", segment_index);
+        }
+        else
+            free(fresh);
     }
-    
-    // continuously loop through the array
-    while (true)
+
+    return segment == NULL ? NULL : &segment[index % POOL_SEGMENT_SIZE];
+}
+
+thread_data *pool_get(tholder_pool_t *pool, size_t index)
+{
+    pool_slot *slot = pool_slot_at(pool, index, false);
+    return slot == NULL ? NULL : atomic_load_explicit(slot, memory_order_acquire);
+}
+
+// Claims a slot with no live thread and marks it as taken. A slot whose worker exited is reused
+// (claimed with a CAS on has_thread), otherwise a new one is appended. Never takes a lock.
+// Returns NULL once all POOL_MAX_SEGMENTS segments are used up
+thread_data *get_inactive_index(tholder_pool_t *pool)
+{
+    size_t size = atomic_load(&pool->size);
+    for (size_t i = 0; i < size; i++)
     {
-        // if we find an uninitialized slot, use it
-        if (thread_pool[index] == NULL)
+        thread_data *td = pool_get(pool, i);
+        bool has_thread = false;
+        if (td != NULL && atomic_compare_exchange_strong(&td->has_thread, &has_thread, true))
         {
-            thread_pool[index] = thread_data_init(index);
-            break;
+            stat_add(&td->stats.respawns, 1);
+            return td;
         }
+    }
+
+    size_t index = atomic_fetch_add(&pool->size, 1);
+    pool_slot *slot = pool_slot_at(pool, index, true);
+    if (slot == NULL)
+        return NULL;
 
-        // if we find an open slot, use it
-        if (!atomic_load(&thread_pool[index]->has_task))
+    thread_data *td = thread_data_init(pool, index);
+    atomic_store(&td->has_thread, true);
+    atomic_store_explicit(slot, td, memory_order_release);
+    return td;
+}
+
+// Takes one worker out of the idle count. Returns false if there was no idle worker
+static bool claim_idle_thread(tholder_pool_t *pool)
+{
+    size_t idle = atomic_load(&pool->idle_threads);
+    while (idle > 0)
+    {
+        if (atomic_compare_exchange_weak(&pool->idle_threads, &idle, idle - 1))
+            return true;
+    }
+    return false;
+}
+
+// Tries every other worker's deque once, starting from a random victim. `td` is NULL outside the pool
+static bool steal_task(tholder_pool_t *pool, thread_data *td, task *t)
+{
+    size_t size = atomic_load(&pool->size);
+    if (size == 0)
+        return false;
+    size_t start = (size_t)rand_r(td != NULL ? &td->rng : &helper_rng) % size;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        thread_data *victim = pool_get(pool, (start + i) % size);
+        if (victim == NULL || victim == td || victim->deque == NULL)
+            continue;
+
+        steal_result res;
+        while ((res = work_deque_steal(victim->deque, t)) == STEAL_ABORT)
+            ;
+        if (res == STEAL_SUCCESS)
+            return true;
+    }
+    return false;
+}
+
+// Takes a task meant for another node. Only done once there is nothing else, so none are stranded
+static bool pop_other_node(tholder_pool_t *pool, thread_data *td, task *t)
+{
+    for (int node = 0; node < pool->num_node_queues; node++)
+        if ((td == NULL || node != td->node) && task_queue_pop(&pool->node_tasks[node], t))
+            return true;
+    return false;
+}
+
+// Looks for work in the high lane first, then our own deque, then our node's queue, then the normal lane,
+// then the other workers, then the queues of other nodes and last the background lane. Every
+// `background_interval` looks, the background lane goes first. `td` is NULL outside the pool
+static bool find_task(tholder_pool_t *pool, thread_data *td, task *t)
+{
+    unsigned int interval = pool->options.background_interval;
+    if (interval != 0 && ++background_turn >= interval)
+    {
+        background_turn = 0;
+        if (task_queue_pop(&pool->background_tasks, t))
+            return true;
+    }
+
+    if (task_queue_pop(&pool->high_tasks, t))
+        return true;
+
+    if (td != NULL && td->deque != NULL && work_deque_take(td->deque, t))
+        return true;
+
+    if (td != NULL && td->node >= 0 && td->node < pool->num_node_queues &&
+        task_queue_pop(&pool->node_tasks[td->node], t))
+        return true;
+
+    if (task_queue_pop(&pool->pending_tasks, t))
+    {
+        // Let a blocked submitter know there is room now
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load(&pool->queue_waiters) > 0)
         {
-            break;
+            atomic_fetch_add(&pool->queue_pops, 1);
+            futex_wake(&pool->queue_pops, 1);
         }
-        // else, keep searching
-        index++;
-        if (index == thread_pool_size)
+        return true;
+    }
+
+    if (pool->options.scheduler == THOLDER_SCHED_STEALING && steal_task(pool, td, t))
+        return true;
+
+    if (pop_other_node(pool, td, t))
+        return true;
+
+    return task_queue_pop(&pool->background_tasks, t);
+}
+
+// Whether an idle worker would find anything to do if it looked now
+static bool work_available(tholder_pool_t *pool)
+{
+    if (!task_queue_empty(&pool->pending_tasks) || !task_queue_empty(&pool->high_tasks) ||
+        !task_queue_empty(&pool->background_tasks))
+        return true;
+
+    if (pool->options.fibers && !task_queue_empty(&pool->resumed_fibers))
+        return true;
+
+    for (int node = 0; node < pool->num_node_queues; node++)
+        if (!task_queue_empty(&pool->node_tasks[node]))
+            return true;
+
+    if (pool->options.scheduler == THOLDER_SCHED_STEALING)
+    {
+        size_t size = atomic_load(&pool->size);
+        for (size_t i = 0; i < size; i++)
         {
-            // thread pool is at capacity and there are no free slots
-            // resize using realloc
+            thread_data *td = pool_get(pool, i);
+            if (td != NULL && td->deque != NULL && !work_deque_empty(td->deque))
+                return true;
+        }
+    }
+    return false;
+}
+
+unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+// Hands `result` to whoever waits for `t`
+static void task_complete(task *t, void *result)
+{
+    if (t->group != NULL)
+    {
+        group_task_done(t->group);
+        return;
+    }
+
+    // Detached, nobody is waiting for the result
+    task_output *output = t->output;
+    if (output == NULL)
+        return;
+
+    output->output = result;
+
+    // Only wake the joiner if it actually went to sleep. Nobody else frees a detached task's output
+    unsigned int state = atomic_exchange(&output->state, OUTPUT_DONE);
+    if (state == OUTPUT_WAITED)
+        futex_wake(&output->state, INT_MAX);
+    else if (state == OUTPUT_FIBER_WAITED)
+        fiber_wake(output->waiter);
+    else if (state == OUTPUT_DETACHED)
+        output_slab_free(output);
+}
+
+void run_task(tholder_pool_t *pool, task *t)
+{
+    // Cancelled before it started, so it is dropped, but its joiner or group still hears about it
+    if (t->cancel != NULL && tholder_is_cancelled(t->cancel))
+    {
+        atomic_fetch_add(&pool->tasks_cancelled, 1);
+        task_complete(t, THOLDER_CANCELLED);
+        return;
+    }
+
+    thread_data *self = worker_of(pool);
+    unsigned long long start = 0;
+    if (self == NULL)
+        atomic_fetch_add(&pool->tasks_run_outside, 1);
+    else if (pool->options.collect_stats)
+    {
+        start = now_ns();
+        if (t->submit_ns != 0 && start > t->submit_ns)
+            stat_add(&self->stats.queue_wait_ns, start - t->submit_ns);
+    }
 
-            pthread_mutex_lock(&thread_pool_lock);
-            
-            thread_pool_size *= 2;
-            thread_pool = realloc(thread_pool, thread_pool_size * sizeof(thread_data *));
-            if (thread_pool == NULL)
-                exit(EXIT_FAILURE);
+    if (tracing)
+        trace_record(TRACE_START, t->trace_id, t->function);
+#ifdef THOLDER_PERF
+    unsigned long long counters[PERF_COUNTERS];
+    perf_read(counters);
+#endif
 
-            dbg("RESIZED THREAS POOL TO %ld\n", thread_pool_size);
+    // Tasks spawned from inside go to the same pool, even if this thread is only helping
+    tholder_pool_t *outer_pool = running_pool;
+    running_pool = pool;
+    tholder_cancel_t *outer_cancel = running_cancel;
+    running_cancel = t->cancel;
+    void *result = t->function(t->args);
 
-            pthread_mutex_unlock(&thread_pool_lock);
-        } 
+    // On a fiber, the task may have been suspended and resumed on another worker. The calls below are
+    // not inlined, so they look up the thread-locals of the thread we are on now
+    swap_running_pool(outer_pool);
+    swap_running_cancel(outer_cancel);
+    thread_data *started_on = self;
+    if (pool->options.fibers)
+        self = this_thread_worker();
+
+#ifdef THOLDER_PERF
+    // The counters of two threads cannot be subtracted
+    if (self == started_on)
+        perf_task_done(t->function, counters);
+#endif
+    if (tracing)
+        trace_record(TRACE_END, t->trace_id, t->function);
+
+    if (self != NULL)
+    {
+        stat_add(&self->stats.tasks_run, 1);
+        if (pool->options.collect_stats && self == started_on)
+            stat_add(&self->stats.busy_ns, now_ns() - start);
     }
-    
-    return thread_pool[index];
+
+    task_complete(t, result);
+}
+
+__attribute__((noinline)) tholder_cancel_t *swap_running_cancel(tholder_cancel_t *cancel)
+{
+    tholder_cancel_t *previous = running_cancel;
+    running_cancel = cancel;
+    return previous;
+}
+
+__attribute__((noinline)) tholder_pool_t *swap_running_pool(tholder_pool_t *pool)
+{
+    tholder_pool_t *previous = running_pool;
+    running_pool = pool;
+    return previous;
+}
+
+bool help_one_task(tholder_pool_t *pool)
+{
+    task t;
+    if (find_task(pool, worker_of(pool), &t))
+    {
+        run_task(pool, &t);
+        return true;
+    }
+
+    // A worker waiting on another pool keeps its own pool going too
+    thread_data *self = current_worker;
+    if (self != NULL && self->pool != pool && find_task(self->pool, self, &t))
+    {
+        run_task(self->pool, &t);
+        return true;
+    }
+    return false;
+}
+
+bool blocking_begin(tholder_pool_t *pool)
+{
+    // A blocked worker stops counting toward its own pool's limit, whichever pool it waits on
+    thread_data *self = current_worker;
+    if (self != NULL)
+        atomic_fetch_add(&self->pool->blocked_threads, 1);
+
+    // A submitter that saw us as running before the increment did not spawn a replacement,
+    // so look at the queue once more before going to sleep
+    atomic_thread_fence(memory_order_seq_cst);
+    if (work_available(pool) || (self != NULL && work_available(self->pool)))
+    {
+        if (self != NULL)
+            atomic_fetch_sub(&self->pool->blocked_threads, 1);
+        return false;
+    }
+    return true;
+}
+
+void blocking_end()
+{
+    if (current_worker != NULL)
+        atomic_fetch_sub(&current_worker->pool->blocked_threads, 1);
+}
+
+void blocking_task_begin()
+{
+    thread_data *self = current_worker;
+    if (self == NULL)
+        return;
+    atomic_fetch_add(&self->pool->blocked_threads, 1);
+
+    // Tasks queued while we still counted as running found no room under `max_active_workers`, start
+    // a worker for them now
+    atomic_thread_fence(memory_order_seq_cst);
+    if (work_available(self->pool))
+        wake_worker(self->pool, NULL);
+}
+
+// Whether a new worker may be started for a task that found nobody idle
+static bool may_spawn_worker(tholder_pool_t *pool)
+{
+    // Past the target of an elastic pool the controller decides. Workers asleep in a join or on their way
+    // out do not count
+    if (pool->options.elastic &&
+        (long)atomic_load(&pool->live_threads) - (long)atomic_load(&pool->blocked_threads) -
+                (long)atomic_load(&pool->retiring_threads) >=
+            (long)atomic_load(&pool->target_workers))
+        return false;
+
+    if (pool->options.max_active_workers == 0)
+        return true;
+
+    // Workers that are idle or asleep in a join are not running anything
+    long running = (long)atomic_load(&pool->live_threads) - (long)atomic_load(&pool->idle_threads) -
+                   (long)atomic_load(&pool->blocked_threads);
+    return running < (long)pool->options.max_active_workers;
 }
 
 void *auxiliary_function(void *args)
 {
     thread_data *td = (thread_data *)args;
-    struct timespec timeout;
-    int ret = -1;
+    tholder_pool_t *pool = td->pool;
+    task t;
+    long keep_alive_ns = pool->options.keep_alive_ms < 0 ? -1 : pool->options.keep_alive_ms * 1000000L;
+    // In an elastic pool, idle workers check every period whether they are above the target
+    if (pool->options.elastic)
+        keep_alive_ns = pool->options.elastic_period_ms * 1000000L;
+    bool retiring = false;
+
+    dbg("[%ld] Waking up via startup\n", td->index);
+    current_worker = td;
+    affinity_bind(td);
+    trace_worker(pool->id, td->index, &td->trace);
+#ifdef THOLDER_PERF
+    perf_worker_start(&td->perf);
+#endif
+
+    if (pool->options.fibers)
+        fiber_worker_start(pool);
 
-    // Check the has_task flag to see if there is work to be done
-    // Additionally, try grabbing the lock. If it is busy, someone is trying to give us work
     while (true)
     {
-        if (ret == ETIMEDOUT)
-            dbg("[%ld] Waking up via timeout\n", td->index); 
-        else if (ret == -1) {
-            dbg("[%ld] Waking up via startup\n", td->index);
-        } else {
-            dbg("[%ld] Woken up by main thread\n", td->index);
+        // Fibers that can go on come first, they are holding on to a stack
+        if (pool->options.fibers && task_queue_pop(&pool->resumed_fibers, &t))
+        {
+            fiber_run(pool, &t);
+            continue;
         }
 
-        pthread_mutex_lock(&td->data_lock);
-
-        if (!atomic_load(&td->has_task)) {
-            break;
+        // Drain the queue before going to sleep. A fiber that yielded gets its turn after each task
+        if (find_task(pool, td, &t))
+        {
+            if (pool->options.fibers)
+            {
+                fiber_run(pool, &t);
+                fiber_run_yielded();
+            }
+            else
+                run_task(pool, &t);
+            continue;
         }
 
-        // Call the function
-        td->output->output = td->function(td->args);
-        pthread_mutex_unlock(&td->output->join);
+        if (pool->options.fibers && fiber_run_yielded())
+            continue;
+
+        if (atomic_load(&pool->shutting_down))
+            break;
 
-        // Set sleep timer
-        clock_gettime(CLOCK_REALTIME, &timeout);
-        timeout.tv_nsec += 1000000;
+        // Advertise ourselves as idle, then look at the queue once more. A submitter that pushed
+        // before seeing our increment did not wake anybody, so its task would otherwise be stranded
+        atomic_fetch_add(&pool->idle_threads, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        unsigned long long idle_start = pool->options.collect_stats ? now_ns() : 0;
 
-        atomic_store(&td->has_task, false);
+        // Spin for a while before parking, so a burst that arrives shortly after this one
+        // does not pay for a futex round-trip. Submitters can already claim us while we spin
+        bool woken = false;
+        for (unsigned int i = 0; i <= pool->options.spin_iterations && !woken; i++)
+        {
+            woken = futex_sem_trywait(&pool->wake_sem) || (work_available(pool) && claim_idle_thread(pool));
+            cpu_relax();
+        }
+        if (!woken)
+        {
+            // Park until (signaled by a submitter OR the keep-alive has passed)
+            if (futex_sem_timedwait(&pool->wake_sem, keep_alive_ns) == 0)
+            {
+                dbg("[%ld] Woken up by submitter\n", td->index);
+                stat_add(&td->stats.signal_wakeups, 1);
+            }
+            else
+            {
+                stat_add(&td->stats.timeout_wakeups, 1);
 
-        // We're done working so unlock the house
-        pthread_mutex_unlock(&td->data_lock);
+                // Timed out. If nobody claimed us in the meantime we are free to exit, unless the
+                // pool is elastic and still wants this many workers
+                if (claim_idle_thread(pool))
+                {
+                    if (pool->options.collect_stats)
+                        stat_add(&td->stats.idle_ns, now_ns() - idle_start);
+                    retiring = !pool->options.elastic || elastic_retire(pool);
+                    if (retiring)
+                    {
+                        dbg("[%ld] Exiting via timeout\n", td->index);
+                        break;
+                    }
+                    continue;
+                }
 
-        // Sleep until (signaled by another thread OR a specified time has passed)
-        pthread_mutex_lock(&td->wait_lock);
-        ret = pthread_cond_timedwait(&td->work_cond_var, &td->wait_lock, &timeout);
-        pthread_mutex_unlock(&td->wait_lock);
+                // A submitter claimed us right before the timeout, its wake-up is on the way
+                futex_sem_timedwait(&pool->wake_sem, -1);
+            }
+        }
 
-        // If a thread is woken up prematurely, it is assumed that there is work to do
-        // Thus, no need to check the return code of `pthread_cond_timedwait()`
-        // Just rerun loop and check has_task condition
+        if (pool->options.collect_stats)
+            stat_add(&td->stats.idle_ns, now_ns() - idle_start);
     }
 
+    if (pool->options.fibers)
+        fiber_worker_stop(pool);
+#ifdef THOLDER_PERF
+    perf_worker_stop();
+#endif
+    output_slab_thread_exit();
     atomic_store(&td->has_thread, false);
-    pthread_mutex_unlock(&td->data_lock);
+    if (retiring && pool->options.elastic)
+        atomic_fetch_sub(&pool->retiring_threads, 1);
+    // Last, once it reaches 0 the pool may be freed under us
+    atomic_fetch_sub(&pool->live_threads, 1);
     return NULL;
 }
 
+int spawn_worker(tholder_pool_t *pool, const pthread_attr_t *attr)
+{
+    // Reserve our place under the limit first, so racing submitters cannot overshoot it
+    size_t live = atomic_load(&pool->live_threads);
+    do
+    {
+        if (pool->options.max_workers != 0 && live >= pool->options.max_workers)
+            return EAGAIN;
+    } while (!atomic_compare_exchange_weak(&pool->live_threads, &live, live + 1));
+
+    thread_data *td = get_inactive_index(pool);
+    if (td == NULL)
+    {
+        atomic_fetch_sub(&pool->live_threads, 1);
+        return EAGAIN;
+    }
+
+    // Create a thread and detatch it. This means it will auto-cleanup on exit
+    pthread_t new_thread;
+    int ret = real_pthread_create(&new_thread, attr, auxiliary_function, (void *)td);
+    if (ret != 0)
+    {
+        atomic_fetch_sub(&pool->live_threads, 1);
+        atomic_store(&td->has_thread, false);
+        return ret;
+    }
+    real_pthread_detach(new_thread);
+    atomic_fetch_add(&pool->threads_spawned, 1);
+    atomic_fetch_add(&threads_spawned, 1);
+
+    dbg("Spawned worker [%ld]\n", td->index);
+    return 0;
+}
+
+// Sleeps until `t` fits in the shared queue
+static void wait_for_queue_space(tholder_pool_t *pool, task *t)
+{
+    do
+    {
+        // Every worker could end up asleep here waiting on the others, so workers run a task instead.
+        // A fiber lets its worker do that, rather than nesting the task on its own small stack
+        if (worker_of(pool) != NULL)
+        {
+            if (fiber_active())
+            {
+                tholder_yield();
+                continue;
+            }
+            if (help_one_task(pool))
+                continue;
+        }
+
+        unsigned int pops = atomic_load(&pool->queue_pops);
+        atomic_fetch_add(&pool->queue_waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        bool pushed = task_queue_push(&pool->pending_tasks, t);
+        if (!pushed)
+            futex_wait(&pool->queue_pops, pops, -1);
+        atomic_fetch_sub(&pool->queue_waiters, 1);
+
+        if (pushed)
+            return;
+    } while (!task_queue_push(&pool->pending_tasks, t));
+}
+
+int submit_task(tholder_pool_t *pool, task *t, const pthread_attr_t *attr)
+{
+    return submit_task_to(pool, t, attr, -1, THOLDER_PRIORITY_NORMAL);
+}
+
+int submit_task_to(tholder_pool_t *pool, task *t, const pthread_attr_t *attr, int node, tholder_priority priority)
+{
+    // High and background tasks go to their own lanes, and a task with a node hint to that node's queue.
+    // Otherwise, in stealing mode a worker keeps the tasks it spawns, unless its deque is full.
+    // Everybody else goes through the shared queue
+    if (pool->options.collect_stats)
+        t->submit_ns = now_ns();
+    if (t->output != NULL)
+        t->output->pool = pool;
+    if (tracing)
+    {
+        t->trace_id = trace_task_id();
+        if (t->output != NULL)
+            t->output->trace_id = t->trace_id;
+        trace_record(TRACE_SUBMIT, t->trace_id, t->function);
+    }
+
+    thread_data *self = worker_of(pool);
+    bool keep_local = pool->options.scheduler == THOLDER_SCHED_STEALING && self != NULL;
+    bool queued = false;
+    if (priority == THOLDER_PRIORITY_HIGH)
+        queued = task_queue_push(&pool->high_tasks, t);
+    else if (priority == THOLDER_PRIORITY_BACKGROUND)
+        queued = task_queue_push(&pool->background_tasks, t);
+    else if (node >= 0 && node < pool->num_node_queues && !(keep_local && self->node == node))
+        queued = task_queue_push(&pool->node_tasks[node], t);
+    else if (keep_local)
+        queued = work_deque_push(self->deque, t);
+
+    if (!queued)
+    {
+        if (!task_queue_push(&pool->pending_tasks, t))
+        {
+            switch (pool->options.saturation_policy)
+            {
+            case THOLDER_SATURATION_INLINE:
+                run_task(pool, t);
+                return 0;
+            case THOLDER_SATURATION_REJECT:
+                return EAGAIN;
+            case THOLDER_SATURATION_BLOCK:
+                wait_for_queue_space(pool, t);
+                break;
+            }
+        }
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+
+    wake_worker(pool, attr);
+    return 0;
+}
+
+void wake_worker(tholder_pool_t *pool, const pthread_attr_t *attr)
+{
+    // Hand the task to a sleeping worker, or spawn one if nobody is idle
+    if (claim_idle_thread(pool))
+    {
+        futex_sem_post(&pool->wake_sem);
+        return;
+    }
+
+    // At the limit, one of the running workers will pick the task up when it is done
+    if (!may_spawn_worker(pool))
+        return;
+
+    // EAGAIN just means `max_workers` are busy, and one of them will get to the task
+    int ret = spawn_worker(pool, attr);
+    if (ret != 0 && ret != EAGAIN && atomic_load(&pool->live_threads) == 0)
+    {
+        // Nobody is left to run the queues, so run them here
+        task left;
+        while (find_task(pool, NULL, &left))
+            run_task(pool, &left);
+    }
+}
+
+// Queues a joinable task on `pool`, see tholder_create(). Without a `cancel` token it inherits the
+// calling task's
+static int create_task(tholder_pool_t *pool, tholder_t *newthread, const pthread_attr_t *attr,
+                       void *(*start_routine)(void *), void *arg, int node, tholder_priority priority,
+                       tholder_cancel_t *cancel)
+{
+    // Take this task's output data from the free list
+    task_output *output = task_output_init();
+    *newthread = (tholder_t)output;
+
+    task t = {start_routine, arg, output, NULL};
+    t.cancel = cancel != NULL ? cancel : running_cancel;
+
+    dbg("Queueing task, storing output at %llu\n", *newthread);
+    int ret = submit_task_to(pool, &t, attr, node, priority);
+    if (ret != 0)
+        output_slab_free(output);
+    return ret;
+}
+
 int tholder_create(tholder_t *__restrict __newthread,
                         const pthread_attr_t *__restrict __attr,
                         void *(*__start_routine)(void *),
                         void *__restrict __arg)
 {
+    return create_task(submit_pool(), __newthread, __attr, __start_routine, __arg, -1, THOLDER_PRIORITY_NORMAL, NULL);
+}
 
-    // Find the next open slot in global array
-    thread_data *td = get_inactive_index();
+int tholder_create_priority(tholder_t *__restrict __newthread,
+                            const pthread_attr_t *__restrict __attr,
+                            void *(*__start_routine)(void *),
+                            void *__restrict __arg,
+                            tholder_priority priority)
+{
+    return create_task(submit_pool(), __newthread, __attr, __start_routine, __arg, -1, priority, NULL);
+}
 
-    // Allocate this task's output data
-    task_output *output = task_output_init();
-    td->output = output;
-    *__newthread = (tholder_t)output;
-    dbg("Starting thread [%ld], storing output at %llu\n", td->index, *__newthread);
-    // Lock the join lock immediately, the auxiliary_function will unlock it.
-    pthread_mutex_lock(&output->join);
-    
-    // Lock the house just to be safe. Getting past this line means the thread has gone to sleep but is not dead
-    pthread_mutex_lock(&td->data_lock);
-    
-    // If there is no thread currently active at the given index, then spawn one
-    bool expected = false;
-    if (!atomic_load(&td->has_thread) && atomic_compare_exchange_strong(&td->has_thread, &expected, true))
-    {
-        // Create a thread and detatch it. This means it will auto-cleanup on exit
-        pthread_t new_thread;
-        pthread_create(&new_thread, __attr, auxiliary_function, (void *)td);
-        pthread_detach(new_thread);
-        threads_spawned++;
-    }
+int tholder_create_on_node(tholder_t *__restrict __newthread,
+                           const pthread_attr_t *__restrict __attr,
+                           void *(*__start_routine)(void *),
+                           void *__restrict __arg,
+                           int node)
+{
+    return create_task(submit_pool(), __newthread, __attr, __start_routine, __arg, node, THOLDER_PRIORITY_NORMAL, NULL);
+}
 
-    // Write the new task function and arguments to the struct 
-    td->function = __start_routine;
-    td->args = __arg;
+int tholder_create_cancellable(tholder_t *__restrict __newthread,
+                               const pthread_attr_t *__restrict __attr,
+                               void *(*__start_routine)(void *),
+                               void *__restrict __arg,
+                               tholder_cancel_t *cancel)
+{
+    return create_task(submit_pool(), __newthread, __attr, __start_routine, __arg, -1, THOLDER_PRIORITY_NORMAL, cancel);
+}
 
-    atomic_store(&td->has_task, true);
-    
-    // Wake up the thread living in this house
-    pthread_cond_broadcast(&td->work_cond_var);
+int tholder_pool_submit(tholder_pool_t *pool, tholder_t *__restrict __newthread,
+                        const pthread_attr_t *__restrict __attr,
+                        void *(*__start_routine)(void *),
+                        void *__restrict __arg)
+{
+    return create_task(pool, __newthread, __attr, __start_routine, __arg, -1, THOLDER_PRIORITY_NORMAL, NULL);
+}
 
-    pthread_mutex_unlock(&td->data_lock);
+int tholder_current_node()
+{
+    return current_worker != NULL ? current_worker->node : -1;
+}
 
-    return 0;
+int tholder_spawn_detached(void *(*__start_routine)(void *), void *__arg)
+{
+    return tholder_pool_spawn_detached(submit_pool(), __start_routine, __arg);
 }
 
-thread_data *thread_data_init(size_t index)
+int tholder_spawn_detached_priority(void *(*__start_routine)(void *), void *__arg, tholder_priority priority)
+{
+    task t = {__start_routine, __arg, NULL, NULL};
+    t.cancel = running_cancel;
+    return submit_task_to(submit_pool(), &t, NULL, -1, priority);
+}
+
+int tholder_spawn_detached_cancellable(void *(*__start_routine)(void *), void *__arg, tholder_cancel_t *cancel)
+{
+    task t = {__start_routine, __arg, NULL, NULL};
+    t.cancel = cancel != NULL ? cancel : running_cancel;
+    return submit_task(submit_pool(), &t, NULL);
+}
+
+int tholder_pool_spawn_detached(tholder_pool_t *pool, void *(*__start_routine)(void *), void *__arg)
+{
+    task t = {__start_routine, __arg, NULL, NULL};
+    t.cancel = running_cancel;
+    return submit_task(pool, &t, NULL);
+}
+
+thread_data *thread_data_init(tholder_pool_t *pool, size_t index)
 {
     thread_data *td = (thread_data *)calloc(1, sizeof(thread_data));
 
     td->index = index;
-    td->args = NULL;
-    td->function = NULL;
+    td->pool = pool;
     atomic_init(&td->has_thread, false);
-    atomic_init(&td->has_task, false);
-    pthread_cond_init(&td->work_cond_var, NULL);
-    pthread_mutex_init(&td->wait_lock, NULL);
-    pthread_mutex_init(&td->data_lock, NULL);
+    td->rng = (unsigned int)index + 1;
+    td->cpu = -1;
+    td->node = -1;
+    td->deque = NULL;
+    if (pool->options.scheduler == THOLDER_SCHED_STEALING)
+        td->deque = work_deque_init(DEFAULT_DEQUE_CAPACITY);
 
     return td;
 }
 
+void tholder_default_options(tholder_options *opts)
+{
+    opts->num_threads = DEFAULT_MAX_THREADS;
+    opts->scheduler = THOLDER_SCHED_FIFO;
+    opts->spin_iterations = DEFAULT_SPIN_ITERATIONS;
+    opts->keep_alive_ms = DEFAULT_KEEP_ALIVE_MS;
+    opts->parallelism = 0;
+    opts->max_active_workers = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    opts->max_workers = 0;
+    opts->queue_capacity = DEFAULT_QUEUE_CAPACITY;
+    opts->saturation_policy = THOLDER_SATURATION_BLOCK;
+    opts->elastic = false;
+    opts->min_workers = 1;
+    opts->target_utilization = DEFAULT_TARGET_UTILIZATION;
+    opts->elastic_period_ms = DEFAULT_ELASTIC_PERIOD_MS;
+    opts->background_interval = DEFAULT_BACKGROUND_INTERVAL;
+    opts->fibers = false;
+    opts->fiber_stack_size = DEFAULT_FIBER_STACK_SIZE;
+    opts->max_fibers = DEFAULT_MAX_FIBERS;
+    opts->reactor_threads = DEFAULT_REACTOR_THREADS;
+    opts->collect_stats = false;
+    opts->dump_stats = false;
+    opts->trace_path = getenv("THOLDER_TRACE");
+    affinity_parse(getenv("THOLDER_AFFINITY"), opts);
+}
+
+// Sets up the queues of `pool`. Must be called with pool->lock held
+static void pool_init(tholder_pool_t *pool, const tholder_options *opts)
+{
+    pool->options = *opts;
+    if (pool->options.parallelism == 0)
+        pool->options.parallelism = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t capacity = pool->options.queue_capacity > 0 ? pool->options.queue_capacity : DEFAULT_QUEUE_CAPACITY;
+
+    // Allocate the segments for the requested number of slots up front. Slots are still
+    // handed out one at a time, so only workers that actually run cost a thread_data
+    size_t slots = pool->options.num_threads > 0 ? pool->options.num_threads : DEFAULT_MAX_THREADS;
+    for (size_t i = 0; i < slots; i += POOL_SEGMENT_SIZE)
+        pool_slot_at(pool, i, true);
+
+    task_queue_init(&pool->pending_tasks, capacity);
+    task_queue_init(&pool->high_tasks, capacity);
+    task_queue_init(&pool->background_tasks, capacity);
+    if (pool->options.fibers)
+    {
+        if (pool->options.fiber_stack_size == 0)
+            pool->options.fiber_stack_size = DEFAULT_FIBER_STACK_SIZE;
+        if (pool->options.max_fibers == 0)
+            pool->options.max_fibers = DEFAULT_MAX_FIBERS;
+        // Room for every fiber at once, so a wake-up never finds it full
+        task_queue_init(&pool->resumed_fibers, pool->options.max_fibers);
+        atomic_store(&pool->fibers_allocated, 0);
+    }
+    pool->node_tasks = NULL;
+    pool->num_node_queues = 0;
+    if (pool->options.affinity != THOLDER_AFFINITY_NONE)
+    {
+        affinity_init();
+        pool->num_node_queues = affinity_num_nodes();
+        pool->node_tasks = (task_queue *)malloc(pool->num_node_queues * sizeof(task_queue));
+        if (pool->node_tasks == NULL)
+            exit(EXIT_FAILURE);
+        for (int node = 0; node < pool->num_node_queues; node++)
+            task_queue_init(&pool->node_tasks[node], capacity);
+    }
+
+    futex_sem_init(&pool->wake_sem, 0);
+    atomic_store(&pool->idle_threads, 0);
+    atomic_store(&pool->blocked_threads, 0);
+    atomic_store(&pool->threads_spawned, 0);
+    atomic_store(&pool->tasks_run_outside, 0);
+    atomic_store(&pool->queue_waiters, 0);
+    pool->reactors = NULL;
+    pool->num_reactors = 0;
+    atomic_store(&pool->reactor_running, false);
+    atomic_store(&pool->fds_waiting, 0);
+    atomic_store(&pool->fd_dispatches, 0);
+    pool->timers = NULL;
+    atomic_store(&pool->timers_running, false);
+    atomic_store(&pool->timers_pending, 0);
+    atomic_store(&pool->timers_fired, 0);
+    atomic_store(&pool->tasks_cancelled, 0);
+    atomic_store(&pool->shutting_down, false);
+    atomic_fetch_add(&active_pools, 1);
+    atomic_store(&pool->initialized, true);
+
+    if (pool->options.elastic)
+        elastic_start(pool);
+}
+
+// Lets the workers of `pool` drain its queues, waits for them to exit and frees what pool_init() set up
+static void pool_shutdown(tholder_pool_t *pool)
+{
+    // The controller would otherwise keep spawning workers to meet its target
+    if (pool->options.elastic)
+        elastic_stop(pool);
+    // Neither would the reactors and the timer thread, with tasks whose fd becomes readable or whose time comes
+    reactor_stop(pool);
+    timer_stop(pool);
+
+    // Workers drain whatever is still queued, then exit instead of going back to sleep
+    atomic_store(&pool->shutting_down, true);
+    while (atomic_load(&pool->live_threads) > 0)
+    {
+        if (atomic_load(&pool->wake_sem.tokens) < atomic_load(&pool->live_threads))
+            futex_sem_post(&pool->wake_sem);
+        sched_yield();
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->options.dump_stats)
+        stats_dump(pool);
+
+    size_t size = atomic_load(&pool->size);
+    for (size_t i = 0; i < size; i++)
+    {
+        // Skip if the slot is NULL, it just means it was handed out past the last segment
+        thread_data *td = pool_get(pool, i);
+        if (td == NULL)
+            continue;
+
+        work_deque_destroy(td->deque);
+        free(td);
+    }
+    for (size_t i = 0; i < POOL_MAX_SEGMENTS; i++)
+    {
+        free(atomic_load(&pool->slots[i]));
+        atomic_store(&pool->slots[i], NULL);
+    }
+    atomic_store(&pool->size, 0);
+
+    reactor_destroy(pool);
+    timer_destroy(pool);
+
+    task_queue_destroy(&pool->pending_tasks);
+    task_queue_destroy(&pool->high_tasks);
+    task_queue_destroy(&pool->background_tasks);
+    if (pool->options.fibers)
+        task_queue_destroy(&pool->resumed_fibers);
+    for (int node = 0; node < pool->num_node_queues; node++)
+        task_queue_destroy(&pool->node_tasks[node]);
+    free(pool->node_tasks);
+    pool->node_tasks = NULL;
+    pool->num_node_queues = 0;
+
+    // Outputs of other pools' tasks come from the same slabs
+    if (atomic_fetch_sub(&active_pools, 1) == 1)
+        output_slab_destroy();
+    atomic_store(&pool->initialized, false);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
 inline void tholder_init(size_t num_threads)
 {
-    pthread_mutex_lock(&thread_pool_lock);
+    tholder_options opts;
+    tholder_default_options(&opts);
+    opts.num_threads = num_threads;
+    tholder_init_opts(&opts);
+}
+
+void tholder_init_opts(const tholder_options *opts)
+{
+    pthread_mutex_lock(&default_pool.lock);
     // After acquiring the lock, check if region is still uninit before moving forward
-    if (thread_pool == NULL)
+    if (!atomic_load(&default_pool.initialized))
     {
-        // Initialize global region with default max threads
-        thread_pool_size = num_threads;
-        thread_pool = (thread_data **)calloc(thread_pool_size, sizeof(thread_data *));
+        // Tracing covers every pool, but only the default pool's options turn it on
+        if (opts->trace_path != NULL)
+            trace_init(opts->trace_path);
+        pool_init(&default_pool, opts);
     }
-    pthread_mutex_unlock(&thread_pool_lock);
+    pthread_mutex_unlock(&default_pool.lock);
 }
 
 inline void tholder_destroy()
 {
-    pthread_mutex_lock(&thread_pool_lock);
+    if (!atomic_load(&default_pool.initialized))
+        return;
 
-    if (thread_pool != NULL)
-    {
-        for (size_t i = 0; i < thread_pool_size; i++)
-        {
-            // Skip if the slot is NULL, it just means it was allocated and never used
-            if (thread_pool[i] == NULL)
-                continue;
+    pool_shutdown(&default_pool);
 
-            pthread_mutex_lock(&thread_pool[i]->data_lock);
-            pthread_mutex_unlock(&thread_pool[i]->data_lock);
-            pthread_cond_destroy(&thread_pool[i]->work_cond_var);
-            pthread_mutex_destroy(&thread_pool[i]->wait_lock);
-            pthread_mutex_destroy(&thread_pool[i]->data_lock);
-            thread_pool[i]->args = NULL;
-            thread_pool[i]->function = NULL;
+    trace_write();
+#ifdef THOLDER_PERF
+    perf_report();
+#endif
+}
 
-            free(thread_pool[i]);
-        }
-        free(thread_pool);
-        thread_pool = NULL;
+tholder_pool_t *tholder_pool_create(const tholder_options *opts)
+{
+    tholder_options defaults;
+    if (opts == NULL)
+    {
+        tholder_default_options(&defaults);
+        opts = &defaults;
     }
 
-    pthread_mutex_unlock(&thread_pool_lock);
-    pthread_mutex_destroy(&thread_pool_lock);
+    tholder_pool_t *pool = (tholder_pool_t *)calloc(1, sizeof(tholder_pool_t));
+    if (pool == NULL)
+        return NULL;
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->id = atomic_fetch_add(&next_pool_id, 1);
+
+    pthread_mutex_lock(&pool->lock);
+    pool_init(pool, opts);
+    pthread_mutex_unlock(&pool->lock);
+    return pool;
+}
+
+void tholder_pool_destroy(tholder_pool_t *pool)
+{
+    pool_shutdown(pool);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
 }
 
 task_output *task_output_init()
 {
-    task_output *output = (task_output *)calloc(1, sizeof(task_output));
+    task_output *output = output_slab_alloc();
     output->output = NULL;
-    pthread_mutex_init(&output->join, NULL);
+    atomic_store_explicit(&output->state, OUTPUT_PENDING, memory_order_relaxed);
     return output;
 }
 
 int tholder_join(tholder_t th, void **thread_return)
 {
-    task_output *output = (task_output *)th; 
-    pthread_mutex_lock(&output->join);
-    pthread_mutex_unlock(&output->join);
+    task_output *output = (task_output *)th;
+    // Help the pool the task is queued on, that is where it can be found
+    tholder_pool_t *pool = output->pool;
+
+    // On a fiber the task is suspended instead, and its worker goes on with other tasks
+    if (atomic_load(&output->state) != OUTPUT_DONE && fiber_active())
+        fiber_join(output);
+
+    if (tracing)
+        trace_record(TRACE_JOIN_BEGIN, output->trace_id, NULL);
+
+    while (atomic_load(&output->state) != OUTPUT_DONE)
+    {
+        // Run queued tasks instead of sitting idle. In stealing mode the task we are waiting on
+        // is usually still at the bottom of our own deque, so we often end up running it ourselves
+        if (help_one_task(pool))
+            continue;
+
+        // Nothing to help with. The task is running somewhere, spin before sleeping
+        for (unsigned int i = 0; i < pool->options.spin_iterations; i++)
+        {
+            if (atomic_load(&output->state) == OUTPUT_DONE)
+                break;
+            cpu_relax();
+        }
+
+        // Tell the worker to wake us up. If the CAS fails the task is either done or already marked
+        unsigned int state = OUTPUT_PENDING;
+        if (!atomic_compare_exchange_strong(&output->state, &state, OUTPUT_WAITED) && state == OUTPUT_DONE)
+            break;
+
+        if (!blocking_begin(pool))
+            continue;
+        while (atomic_load(&output->state) != OUTPUT_DONE)
+            futex_wait(&output->state, OUTPUT_WAITED, -1);
+        blocking_end();
+    }
 
     // If thread_return is not NULL, we must copy the return value over
     if (thread_return != NULL)
         memcpy(thread_return, &output->output, sizeof(void *));
 
-    pthread_mutex_destroy(&output->join);
-    free(output);
+    if (tracing)
+        trace_record(TRACE_JOIN_END, output->trace_id, NULL);
+    output_slab_free(output);
+
+    return 0;
+}
+
+int tholder_detach(tholder_t th)
+{
+    task_output *output = (task_output *)th;
 
+    // If the task already returned, its output is ours to free
+    unsigned int state = OUTPUT_PENDING;
+    if (!atomic_compare_exchange_strong(&output->state, &state, OUTPUT_DETACHED))
+        output_slab_free(output);
     return 0;
 }
@@ -1,49 +1,374 @@
+#ifndef THOLDER_H
+#define THOLDER_H
+
 #include <stdbool.h>
 #include <stdatomic.h>
 
 #include <unistd.h>
 #include <pthread.h>
-#include <semaphore.h>
 
 /* DEFINES */
 #ifndef DEBUG
 #define DEBUG false
-#endif 
+#endif
 
 #define DEFAULT_MAX_THREADS 8
 
-extern size_t threads_spawned;
+// Number of tasks that can be waiting for a worker at once
+#define DEFAULT_QUEUE_CAPACITY 1024
+
+// How long an idle worker stays parked before it exits
+#define DEFAULT_KEEP_ALIVE_MS 1
+
+// Pass as `keep_alive_ms` to keep idle workers parked until tholder_destroy()
+#define THOLDER_KEEP_ALIVE_FOREVER -1
+
+// How many times an idle worker re-checks for work before parking
+#define DEFAULT_SPIN_ITERATIONS 100
+
+// Defaults of fiber mode, see the `fibers` option
+#define DEFAULT_FIBER_STACK_SIZE (256 * 1024)
+#define DEFAULT_MAX_FIBERS 4096
+
+// Defaults of the elastic controller, see the `elastic` option
+#define DEFAULT_TARGET_UTILIZATION 75
+#define DEFAULT_ELASTIC_PERIOD_MS 10
+
+// Threads waiting on epoll for tholder_submit_on_readable(), see the `reactor_threads` option
+#define DEFAULT_REACTOR_THREADS 1
+
+// Background tasks get at least every this many turns at the queues, see `background_interval`
+#define DEFAULT_BACKGROUND_INTERVAL 16
+
+// Worker slots are allocated this many at a time, in segments that never move
+#define POOL_SEGMENT_SIZE 64
+
+// Upper bound on segments, and so on POOL_SEGMENT_SIZE * POOL_MAX_SEGMENTS worker slots
+#define POOL_MAX_SEGMENTS 1024
+
+// Number of tasks each worker can hold in its own deque in work-stealing mode
+#define DEFAULT_DEQUE_CAPACITY 256
+
+extern atomic_size_t threads_spawned;
+
+// Number of slabs of task_output structs taken from the heap. Stays flat once the
+// free lists are warm, see output_slab.c
+extern atomic_size_t task_output_allocations;
 
 // Used as a pointer to the task
 typedef unsigned long long tholder_t;
 
+// An independent set of workers with its own queues, options and statistics, see tholder_pool_create()
+typedef struct tholder_pool tholder_pool_t;
+
+// What a submitter does when the shared queue is full
+typedef enum tholder_saturation_policy
+{
+    // Wait until a worker takes a task off the queue. Workers run queued tasks while they wait
+    THOLDER_SATURATION_BLOCK,
+    // Run the task on the submitting thread
+    THOLDER_SATURATION_INLINE,
+    // Fail the submission with EAGAIN
+    THOLDER_SATURATION_REJECT
+} tholder_saturation_policy;
+
+// Order in which queued tasks are picked up. Priorities only decide which task a free worker takes next,
+// a running task is never interrupted
+typedef enum tholder_priority
+{
+    // Latency-critical, taken before anything else
+    THOLDER_PRIORITY_HIGH,
+    // What tholder_create() and every other call without a priority uses
+    THOLDER_PRIORITY_NORMAL,
+    // Throughput work, only taken when nothing else is queued or on its guaranteed turn
+    THOLDER_PRIORITY_BACKGROUND
+} tholder_priority;
+
+// How tasks are handed to workers
+typedef enum tholder_scheduler
+{
+    // Every task goes through the shared queue in submission order
+    THOLDER_SCHED_FIFO,
+    // Tasks submitted by a worker go to its own deque, idle workers steal from random victims
+    THOLDER_SCHED_STEALING
+} tholder_scheduler;
+
+// Where worker threads are pinned, see the `affinity` option
+typedef enum tholder_affinity
+{
+    // Workers run wherever the kernel puts them
+    THOLDER_AFFINITY_NONE,
+    // Worker i on one CPU each, filling a NUMA node before moving on to the next
+    THOLDER_AFFINITY_COMPACT,
+    // Worker i on one CPU each, alternating between NUMA nodes and using separate cores before hyperthreads
+    THOLDER_AFFINITY_SCATTER,
+    // Worker i on cpu_list[i % cpu_list_size]
+    THOLDER_AFFINITY_LIST,
+    // Workers take turns between NUMA nodes and may move between the CPUs of their node
+    THOLDER_AFFINITY_NUMA
+} tholder_affinity;
+
+// Settings read once by tholder_init_opts(). Start from tholder_default_options()
+typedef struct tholder_options
+{
+    // Initial number of worker slots
+    size_t num_threads;
+    tholder_scheduler scheduler;
+
+    // An idle worker spins this many times, then parks on a futex, then exits
+    // after `keep_alive_ms` without work
+    unsigned int spin_iterations;
+    long keep_alive_ms;
+
+    // Number of lanes tholder_parallel_for() splits a range into, 0 means one per online CPU
+    size_t parallelism;
+
+    // 0 spawns a new worker whenever a task finds nobody idle. Otherwise at most this many
+    // workers run tasks at once, and extra tasks wait in the queue. Workers asleep in a join
+    // do not count, since joins run queued tasks and only sleep when there is nothing to run
+    size_t max_active_workers;
+
+    // Hard limit on live worker threads, 0 means no limit. Once it is reached, tasks that find
+    // nobody idle wait in the queue
+    size_t max_workers;
+    // Number of tasks that can wait in the shared queue, rounded up to a power of two
+    size_t queue_capacity;
+    tholder_saturation_policy saturation_policy;
+
+    // Size the pool with a controller thread instead (see elastic.c). Every `elastic_period_ms` it picks a
+    // worker count between `min_workers` and `max_workers` that would keep `target_utilization` percent
+    // of them busy. Workers above that count exit after `elastic_period_ms` idle, and the others stay parked
+    // regardless of `keep_alive_ms`. Submitters do not spawn past it, the controller grows it instead
+    bool elastic;
+    size_t min_workers;
+    unsigned int target_utilization;
+    long elastic_period_ms;
+
+    // Run every task on a fiber, a pooled stack of `fiber_stack_size` bytes that the worker switches to in
+    // user space (see fiber.c). A task that joins an unfinished task, or calls tholder_yield(), is suspended
+    // and resumed later on any worker of the pool, instead of helping or putting its thread to sleep. Its
+    // thread-locals, pthread_self() and the owner of mutexes it holds can change across such a join.
+    // Past `max_fibers` per pool, tasks run on their worker's own stack and join the usual way
+    bool fibers;
+    size_t fiber_stack_size;
+    size_t max_fibers;
+
+    // Every this many times a thread looks for work, it checks the background lane first, so background
+    // tasks keep moving under a steady stream of other work. 0 gives strict priority
+    unsigned int background_interval;
+
+    // Number of epoll threads behind tholder_submit_on_readable() (see reactor.c), started on its first call.
+    // An fd always goes to the same one
+    size_t reactor_threads;
+
+    // Also time tasks and idle periods for tholder_stats(). Costs a few clock reads per task
+    bool collect_stats;
+    // Print per-worker statistics to stderr in tholder_destroy()
+    bool dump_stats;
+    // Record task events and write them to this file as Chrome trace JSON in tholder_destroy().
+    // NULL turns tracing off. Defaults to the THOLDER_TRACE environment variable
+    const char *trace_path;
+
+    // Pins each worker when it starts. Defaults to the THOLDER_AFFINITY environment variable:
+    // "compact", "scatter", "numa" or a CPU list such as "0,2,4-7"
+    tholder_affinity affinity;
+    const int *cpu_list;
+    size_t cpu_list_size;
+} tholder_options;
+
+// How tholder_parallel_for() hands out iterations
+typedef enum tholder_schedule
+{
+    // One contiguous block per lane, decided up front
+    THOLDER_STATIC,
+    // Lanes repeatedly claim `grain` iterations from a shared cursor
+    THOLDER_DYNAMIC,
+    // Like dynamic, but chunks start large and shrink toward `grain` as the range runs out
+    THOLDER_GUIDED
+} tholder_schedule;
+
+// Loop body for tholder_parallel_for(), called on the half-open range [begin, end)
+typedef void (*tholder_range_fn)(size_t begin, size_t end, void *ctx);
+
+// Cooperative cancellation of a tree of tasks, see cancel.c. Initialize with THOLDER_CANCEL_INIT or
+// tholder_cancel_init()
+typedef struct tholder_cancel_t
+{
+    atomic_bool cancelled;
+    // Cancelling the parent cancels this token as well, NULL for a root
+    struct tholder_cancel_t *parent;
+} tholder_cancel_t;
+
+#define THOLDER_CANCEL_INIT {false, NULL}
+
+// Result tholder_join() returns for a task that was dropped because its token was cancelled before it started
+#define THOLDER_CANCELLED ((void *)-1)
+
+// A set of tasks that are waited on together. Initialize with THOLDER_GROUP_INIT or tholder_group_init()
+typedef struct tholder_group_t
+{
+    // Low bits count the unfinished tasks, GROUP_WAITER_BIT is set once somebody sleeps in
+    // tholder_group_wait(). Doubles as the futex word
+    atomic_uint state;
+    // Token given to the tasks spawned into the group, see tholder_group_set_cancel()
+    tholder_cancel_t *cancel;
+} tholder_group_t;
+
+#define THOLDER_GROUP_INIT {0}
+
+// Result of a task that can be waited on, chained, or combined with other futures. Reference counted
+typedef struct tholder_future tholder_future_t;
+
+// Continuation for tholder_then(). Gets the value of the future it was chained to
+typedef void *(*tholder_continuation_fn)(void *value, void *ctx);
+
+// Tasks that declare which data they read and write, and only run once the tasks before them
+// that touch the same data are done. See tholder_dag_submit()
+typedef struct tholder_dag tholder_dag_t;
+
+// A piece of data that DAG tasks depend on, e.g. one tile of a matrix. Initialize with
+// THOLDER_HANDLE_INIT and free with tholder_handle_destroy()
+typedef struct tholder_handle_t
+{
+    // The last task that writes the data, and the tasks that read it since then
+    struct dag_node *last_writer;
+    struct dag_node **readers;
+    size_t num_readers;
+    size_t readers_capacity;
+    // Generation of the DAG the fields above belong to. They are stale once it changes
+    unsigned long long generation;
+} tholder_handle_t;
+
+#define THOLDER_HANDLE_INIT {NULL, NULL, 0, 0, 0}
+
+typedef enum tholder_access
+{
+    THOLDER_READ,
+    // Read-write
+    THOLDER_WRITE
+} tholder_access;
+
+typedef struct tholder_dep_t
+{
+    tholder_handle_t *handle;
+    tholder_access access;
+} tholder_dep_t;
+
+// A fixed set of threads that run phases together, see tholder_team_create()
+typedef struct tholder_team tholder_team_t;
+
+// Body of one team phase. Every member calls it with its own `member` index in [0, tholder_team_size())
+typedef void (*tholder_phase_fn)(tholder_team_t *team, size_t member, void *ctx);
+
 // Holds the status and return values of a task
 typedef struct task_output
 {
     void *output;
-    pthread_mutex_t join;
+    // OUTPUT_PENDING, OUTPUT_DONE, OUTPUT_WAITED or OUTPUT_DETACHED. Doubles as the futex word tholder_join() sleeps on
+    atomic_uint state;
+    // Next entry while the struct sits on a free list
+    struct task_output *next_free;
+    // Links the join to the task's other events when tracing
+    unsigned long long trace_id;
+    // The pool the task was queued on, whose queue tholder_join() helps with
+    tholder_pool_t *pool;
+    // The fiber suspended in tholder_join(), with OUTPUT_FIBER_WAITED
+    struct fiber *waiter;
 } task_output;
 
+// Counters kept per worker slot. Only the slot's current worker writes them, so they never
+// bounce between caches, and tholder_stats() can read them at any time
+typedef struct worker_stats
+{
+    atomic_ullong tasks_run;
+    // The timings are only collected with the `collect_stats` option
+    atomic_ullong busy_ns;
+    atomic_ullong idle_ns;
+    // Time the tasks this worker ran spent queued before they started
+    atomic_ullong queue_wait_ns;
+    // Times the worker was woken up by a submitter, and times its keep-alive ran out
+    atomic_ullong signal_wakeups;
+    atomic_ullong timeout_wakeups;
+    // Workers started in this slot after an earlier one exited
+    atomic_ullong respawns;
+} worker_stats;
+
+// Handle of a timer armed by tholder_submit_after() or tholder_submit_every(), used to cancel it
+typedef struct tholder_timer_t
+{
+    tholder_pool_t *pool;
+    unsigned long long id;
+} tholder_timer_t;
+
+// Snapshot returned by tholder_stats(), summed over every worker slot
+typedef struct tholder_stats_t
+{
+    // Slots that ever had a worker, and workers alive right now
+    size_t workers;
+    size_t live_workers;
+    size_t threads_spawned;
+
+    unsigned long long tasks_run;
+    // Tasks run by threads outside the pool, while helping in a join or inline on submission
+    unsigned long long tasks_run_outside;
+    unsigned long long busy_ns;
+    unsigned long long idle_ns;
+    unsigned long long queue_wait_ns;
+    unsigned long long signal_wakeups;
+    unsigned long long timeout_wakeups;
+    unsigned long long respawns;
+
+    // Decisions of the elastic controller: the worker count it aims for, the percentage of workers busy
+    // over its last period, and how often it raised or lowered the count
+    size_t target_workers;
+    unsigned int utilization;
+    unsigned long long elastic_grows;
+    unsigned long long elastic_shrinks;
+
+    // Fiber stacks the pool has right now, running, suspended or cached, see the `fibers` option
+    size_t fibers;
+
+    // Tasks waiting for their fd in tholder_submit_on_readable(), and tasks queued once it became readable
+    size_t fds_waiting;
+    unsigned long long fd_dispatches;
+
+    // Timers armed right now, and tasks queued by timers so far
+    size_t timers_pending;
+    unsigned long long timers_fired;
+
+    // Tasks dropped because their cancellation token was cancelled before they started
+    unsigned long long tasks_cancelled;
+} tholder_stats_t;
+
+// One slot per worker thread. Tasks are not tied to a slot, they are pulled from the shared queue
 typedef struct thread_data
 {
     // Index of thread_data struct in thread_pool, used for debugging
     size_t index;
 
-    // Condition variable used in `pthread_cond_timedwait();
-    pthread_cond_t work_cond_var;
-    // Mutex lock used in `pthread_cond_timedwait();
-    pthread_mutex_t wait_lock;
-
     atomic_bool has_thread;
-    atomic_bool has_task;
+    tholder_pool_t *pool;
+
+    // Tasks spawned by this worker, only allocated in THOLDER_SCHED_STEALING mode
+    struct work_deque *deque;
+    // State for picking a random victim to steal from
+    unsigned int rng;
+
+    // Where the worker is pinned, -1 if it is not
+    int cpu;
+    int node;
 
-    // Lock that should be used when accessing function & args
-    pthread_mutex_t data_lock;
-    void *(*function)(void *);
-    void *args;
-    task_output *output;
+    // Ring of the slot's trace track and its counter totals under `make PERF=1`, kept when the worker exits
+    // so the next one in the slot reuses them
+    struct trace_buffer *trace;
+    struct perf_worker *perf;
+
+    worker_stats stats;
 } thread_data;
 
+// Queues `__start_routine(__arg)` on the pool of the calling task, or on the default pool when called from
+// outside any task. This goes for all the functions below that take no pool. Returns 0, or EAGAIN if the queue is full and
+// the saturation policy is THOLDER_SATURATION_REJECT
 int tholder_create(tholder_t *__restrict __newthread,
                          const pthread_attr_t *__restrict __attr,
                          void *(*__start_routine)(void *),
@@ -51,14 +376,203 @@ int tholder_create(tholder_t *__restrict __newthread,
 
 int tholder_join(tholder_t th, void **thread_return);
 
+// On a fiber, suspends the calling task until its worker has run one other task, or has nothing else to
+// run. Elsewhere the same as sched_yield()
+void tholder_yield();
+
+// Gives up on joining `th`. Its output is freed as soon as the task returns, or right away if it already has.
+// Like pthread_detach(), `th` must not be joined or detached afterwards
+int tholder_detach(tholder_t th);
+
+// Runs `__start_routine(__arg)` on the pool without any join state. The return value is discarded,
+// and nothing is left to clean up once the task returns. Same return codes as tholder_create()
+int tholder_spawn_detached(void *(*__start_routine)(void *), void *__arg);
+
+// Queues `fn(arg)` like tholder_spawn_detached(), but only once `fd` is readable, or hung up. Until then
+// it waits on a reactor thread of the pool, not on a worker. The wait is one-shot: `fd` must stay open until
+// the task runs, and the task calls this again to wait for more. Returns 0, EEXIST if `fd` already has a
+// task waiting, or the errno of epoll_ctl() (EPERM for regular files). Tasks still waiting when the pool
+// is destroyed are dropped without running
+int tholder_submit_on_readable(int fd, void *(*fn)(void *), void *arg);
+
+// Queues `fn(arg)` like tholder_spawn_detached(), but not before `delay_ns` have passed. Until then it
+// costs an entry in the pool's timer wheel (see timer.c), not a worker. Delays are rounded up to whole
+// milliseconds. If `timer` is not NULL it receives a handle for tholder_timer_cancel(). Returns 0, ENOMEM,
+// or EAGAIN once the pool is shutting down. Timers still armed when the pool is destroyed are dropped
+int tholder_submit_after(tholder_timer_t *timer, unsigned long long delay_ns, void *(*fn)(void *), void *arg);
+
+// Same, but queues `fn(arg)` every `period_ns` until the timer is cancelled. The schedule does not drift
+// with how long the tasks take, so runs may overlap, and runs missed while the pool was behind are skipped.
+// EINVAL for a period of 0
+int tholder_submit_every(tholder_timer_t *timer, unsigned long long period_ns, void *(*fn)(void *), void *arg);
+
+// Disarms `timer`. Returns false if it already fired, or was cancelled before. A task it queued already
+// still runs
+bool tholder_timer_cancel(tholder_timer_t timer);
+
+// Tasks created from inside a task inherit its cancellation token, unless they are given one of their own.
+// Once the token is cancelled, tasks holding it that have not started are dropped: a join returns
+// THOLDER_CANCELLED and a group counts them as done. Running tasks are never interrupted, they poll
+// tholder_cancel_requested() instead. Futures and DAG tasks do not take a token
+int tholder_create_cancellable(tholder_t *__restrict __newthread,
+                               const pthread_attr_t *__restrict __attr,
+                               void *(*__start_routine)(void *),
+                               void *__restrict __arg,
+                               tholder_cancel_t *cancel);
+
+int tholder_spawn_detached_cancellable(void *(*__start_routine)(void *), void *__arg, tholder_cancel_t *cancel);
+
+void tholder_cancel_init(tholder_cancel_t *token, tholder_cancel_t *parent);
+
+// Cancels `token` and every token below it. Cannot be undone
+void tholder_cancel(tholder_cancel_t *token);
+
+// Whether `token` or one of its parents was cancelled. False for NULL
+bool tholder_is_cancelled(const tholder_cancel_t *token);
+
+// Token of the running task, NULL outside a task or for a task without one
+tholder_cancel_t *tholder_current_cancel();
+
+// Whether the running task's token was cancelled, cheap enough to poll in a loop
+bool tholder_cancel_requested();
+
+// Like tholder_create(), but the task is queued in the lane of `priority`. If that lane is full it goes
+// to the normal one
+int tholder_create_priority(tholder_t *__restrict __newthread,
+                            const pthread_attr_t *__restrict __attr,
+                            void *(*__start_routine)(void *),
+                            void *__restrict __arg,
+                            tholder_priority priority);
+
+int tholder_spawn_detached_priority(void *(*__start_routine)(void *), void *__arg, tholder_priority priority);
+
+// Like tholder_create(), but the task waits in a queue of NUMA node `node`, which workers of that node
+// check before anything else. Workers elsewhere only take it once they run out of other work.
+// Without an `affinity` option workers have no node and the hint is ignored
+int tholder_create_on_node(tholder_t *__restrict __newthread,
+                           const pthread_attr_t *__restrict __attr,
+                           void *(*__start_routine)(void *),
+                           void *__restrict __arg,
+                           int node);
+
+// NUMA node of the memory at `addr`, -1 if it cannot be told
+int tholder_node_of(const void *addr);
+
+// NUMA node the calling worker is pinned to, -1 outside the pool or without an `affinity` option
+int tholder_current_node();
+
 void tholder_init(size_t num_threads);
 
-thread_data *thread_data_init(size_t index);
+void tholder_default_options(tholder_options *opts);
+
+void tholder_init_opts(const tholder_options *opts);
+
+// Runs `body` over [begin, end) on the pool and returns once every iteration is done.
+// The calling thread runs one of the lanes itself. No chunk is smaller than `grain`, except the last one of the
+// dynamic and guided schedules and a range that is smaller than `grain` as a whole. Returns 0, or ECANCELED if the
+// caller's cancellation token dropped a lane before it started, in which case some iterations may not have run
+int tholder_parallel_for(size_t begin, size_t end, size_t grain, tholder_schedule schedule,
+                         tholder_range_fn body, void *ctx);
+
+void tholder_group_init(tholder_group_t *group);
+
+// Runs `__start_routine(__arg)` on the pool as part of `group`. Its return value is discarded
+int tholder_group_spawn(tholder_group_t *group, void *(*__start_routine)(void *), void *__arg);
+
+// Tasks spawned into `group` from now on take `token` instead of inheriting the spawning task's
+void tholder_group_set_cancel(tholder_group_t *group, tholder_cancel_t *token);
+
+// Blocks until every task spawned into `group` so far has returned. Costs a single wake-up
+// no matter how many tasks there were. The group can be reused afterwards
+void tholder_group_wait(tholder_group_t *group);
+
+// Runs `fn(arg)` on the pool. The future completes with its return value
+tholder_future_t *tholder_async(void *(*fn)(void *), void *arg);
+
+// Once `future` completes, runs `fn(value, ctx)` as a new task on the pool. The returned
+// future completes with its return value. Nobody blocks in between
+tholder_future_t *tholder_then(tholder_future_t *future, tholder_continuation_fn fn, void *ctx);
+
+// Completes with NULL once every future in `futures` is done. Read their values with tholder_future_get()
+tholder_future_t *tholder_when_all(tholder_future_t *const *futures, size_t count);
+
+// Completes with the value of whichever future in `futures` is done first
+tholder_future_t *tholder_when_any(tholder_future_t *const *futures, size_t count);
+
+bool tholder_future_ready(tholder_future_t *future);
+
+// Blocks until `future` is done, running queued tasks meanwhile, and returns its value
+void *tholder_future_get(tholder_future_t *future);
+
+// Drops the caller's reference. Pending tasks and continuations keep their own until they are done
+void tholder_future_release(tholder_future_t *future);
+
+tholder_dag_t *tholder_dag_create();
+
+// Runs `fn(arg)` on the pool once every earlier task of `dag` it conflicts with is done: a read waits
+// for the last write to the same handle, a write waits for the last write and every read since.
+// Submitting in program order therefore gives the same result as running the tasks one by one
+int tholder_dag_submit(tholder_dag_t *dag, void *(*fn)(void *), void *arg, const tholder_dep_t *deps, size_t num_deps);
+
+// Blocks until every task submitted to `dag` so far is done, running tasks meanwhile. Frees their bookkeeping
+void tholder_dag_wait(tholder_dag_t *dag);
+
+// Waits for the remaining tasks and frees `dag`
+void tholder_dag_destroy(tholder_dag_t *dag);
+
+void tholder_handle_destroy(tholder_handle_t *handle);
+
+// Starts `members - 1` threads that stay bound to the team until tholder_team_destroy(). The thread
+// calling tholder_team_run() is member 0. Returns NULL if the threads could not be created
+tholder_team_t *tholder_team_create(size_t members);
+
+size_t tholder_team_size(const tholder_team_t *team);
+
+// Runs `fn` on every member, including the caller as member 0, and returns once all of them are done
+void tholder_team_run(tholder_team_t *team, tholder_phase_fn fn, void *ctx);
+
+// Called by every member from inside a phase. Returns once all members have reached it
+void tholder_team_barrier(tholder_team_t *team);
+
+// Stops and joins the team threads. Must not be called while a phase is running
+void tholder_team_destroy(tholder_team_t *team);
+
+// Fills `stats` with counters summed over every worker slot. Safe to call while tasks are running
+void tholder_stats(tholder_stats_t *stats);
+
+// Starts a pool that shares nothing with the default one: its own workers, queues and statistics.
+// NULL takes tholder_default_options(). Returns NULL if out of memory
+tholder_pool_t *tholder_pool_create(const tholder_options *opts);
+
+// Queues `__start_routine(__arg)` on `pool`. Join it with tholder_join(). Same return codes as tholder_create()
+int tholder_pool_submit(tholder_pool_t *pool, tholder_t *__restrict __newthread,
+                        const pthread_attr_t *__restrict __attr,
+                        void *(*__start_routine)(void *),
+                        void *__restrict __arg);
+
+int tholder_pool_spawn_detached(tholder_pool_t *pool, void *(*__start_routine)(void *), void *__arg);
+
+int tholder_pool_submit_on_readable(tholder_pool_t *pool, int fd, void *(*fn)(void *), void *arg);
+
+int tholder_pool_submit_after(tholder_pool_t *pool, tholder_timer_t *timer, unsigned long long delay_ns,
+                              void *(*fn)(void *), void *arg);
+
+int tholder_pool_submit_every(tholder_pool_t *pool, tholder_timer_t *timer, unsigned long long period_ns,
+                              void *(*fn)(void *), void *arg);
+
+void tholder_pool_stats(tholder_pool_t *pool, tholder_stats_t *stats);
+
+// Lets the workers drain the queues, waits for them to exit and frees `pool`
+void tholder_pool_destroy(tholder_pool_t *pool);
+
+thread_data *thread_data_init(tholder_pool_t *pool, size_t index);
 
 void tholder_destroy();
 
 void *auxiliary_function(void *args);
 
-thread_data *get_inactive_index();
+thread_data *get_inactive_index(tholder_pool_t *pool);
 
 task_output *task_output_init();
+
+#endif
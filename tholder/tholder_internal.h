@@ -0,0 +1,202 @@
+#ifndef THOLDER_INTERNAL_H
+#define THOLDER_INTERNAL_H
+
+#include "tholder.h"
+#include "task_queue.h"
+#include "futex.h"
+
+// Library state shared between the source files of libtholder. Not part of the public API
+
+// The library starts and joins its own threads through these. In the LD_PRELOAD build (`make preload`)
+// pthread_create() and friends are interposed by preload.c, so there these go to libc's versions instead
+#ifdef THOLDER_PRELOAD
+int real_pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg);
+int real_pthread_join(pthread_t thread, void **retval);
+int real_pthread_detach(pthread_t thread);
+pthread_t real_pthread_self();
+#else
+#define real_pthread_create pthread_create
+#define real_pthread_join pthread_join
+#define real_pthread_detach pthread_detach
+#define real_pthread_self pthread_self
+#endif
+
+typedef _Atomic(thread_data *) pool_slot;
+
+// States of task_output.state
+enum
+{
+    OUTPUT_PENDING,
+    OUTPUT_DONE,
+    // Still running, and somebody is asleep in tholder_join()
+    OUTPUT_WAITED,
+    // Still running, and nobody will join it, see tholder_detach()
+    OUTPUT_DETACHED,
+    // Still running, and a fiber is suspended in tholder_join() waiting for it, see fiber.c
+    OUTPUT_FIBER_WAITED
+};
+
+// Everything one pool of workers owns. The global API works on `default_pool`, see tholder_pool_create()
+struct tholder_pool
+{
+    // Settings the pool was initialized with
+    tholder_options options;
+    // 0 for the default pool, and unique for every other, so traces can tell the workers apart
+    size_t id;
+
+    // Serializes initialization and shutdown. Spawning and reading slots never take it
+    pthread_mutex_t lock;
+    atomic_bool initialized;
+    atomic_bool shutting_down;
+
+    // Worker slots live in fixed-size segments that are allocated on first use and never moved
+    // or freed before shutdown, so the pool grows without invalidating concurrent readers
+    _Atomic(pool_slot *) slots[POOL_MAX_SEGMENTS];
+    // Number of slots handed out so far. A slot below it may still be NULL for a moment,
+    // until its spawner has filled it in
+    atomic_size_t size;
+
+    // Tasks waiting for a worker, in the normal lane, and the lanes of the other priorities
+    task_queue pending_tasks;
+    task_queue high_tasks;
+    task_queue background_tasks;
+    // Tasks submitted with a NUMA node hint, one queue per node. Only allocated with an `affinity` option
+    task_queue *node_tasks;
+    int num_node_queues;
+
+    // Workers parked on `wake_sem` that no submitter has claimed yet
+    atomic_size_t idle_threads;
+    // Workers currently alive
+    atomic_size_t live_threads;
+    // Workers asleep in a join because there was nothing left to help with
+    atomic_size_t blocked_threads;
+    atomic_size_t threads_spawned;
+    // Tasks run by threads outside the pool, see tholder_stats()
+    atomic_ullong tasks_run_outside;
+
+    // Fibers that can go on, in fiber mode (see fiber.c), and how many stacks the pool has
+    task_queue resumed_fibers;
+    atomic_size_t fibers_allocated;
+
+    // Reactor threads behind tholder_submit_on_readable(), see reactor.c. Started on first use, and
+    // `reactors` is only read once `reactor_running` is set
+    struct reactor *reactors;
+    size_t num_reactors;
+    atomic_bool reactor_running;
+    // eventfd that every reactor watches, written to stop them
+    int reactor_stop_fd;
+    atomic_size_t fds_waiting;
+    atomic_ullong fd_dispatches;
+
+    // Timer wheel behind tholder_submit_after() and tholder_submit_every(), see timer.c. Started on first use,
+    // and `timers` is only read once `timers_running` is set
+    struct timer_wheel *timers;
+    atomic_bool timers_running;
+    atomic_size_t timers_pending;
+    atomic_ullong timers_fired;
+    // Tasks dropped because their token was cancelled, see tholder_create_cancellable()
+    atomic_ullong tasks_cancelled;
+
+    // Elastic sizing, see elastic.c. The worker count the controller aims for, and workers that decided
+    // to exit but are still counted in `live_threads`
+    atomic_size_t target_workers;
+    atomic_size_t retiring_threads;
+    pthread_t controller;
+    // Set to stop the controller, which sleeps on it between samples
+    atomic_uint controller_stop;
+    atomic_uint utilization;
+    atomic_ullong elastic_grows;
+    atomic_ullong elastic_shrinks;
+
+    // Submitters asleep until the shared queue has room, and the futex word they sleep on
+    atomic_uint queue_waiters;
+    atomic_uint queue_pops;
+    futex_sem wake_sem;
+};
+
+extern tholder_pool_t default_pool;
+
+// The pool of the task running on the calling thread, else the pool of the calling worker,
+// else the default pool
+tholder_pool_t *current_pool();
+
+// Same, but initializes the default pool if it is used before tholder_init()
+tholder_pool_t *submit_pool();
+
+// Cancellation token of the task running on the calling thread, see tholder_create_cancellable()
+tholder_cancel_t *current_cancel();
+
+// Queues `t` on `pool` (on the current worker's deque in stealing mode) and wakes or spawns a worker for it
+int submit_task(tholder_pool_t *pool, struct task *t, const pthread_attr_t *attr);
+
+// Same, but queues the task in the lane of `priority`, or for NUMA node `node` on that node's queue
+// (see tholder_create_on_node()) unless `node` is -1
+int submit_task_to(tholder_pool_t *pool, struct task *t, const pthread_attr_t *attr, int node,
+                   tholder_priority priority);
+
+// Runs `t` on the calling thread and completes its output or group
+void run_task(tholder_pool_t *pool, struct task *t);
+
+// Wakes an idle worker of `pool` for a task that was just queued, or spawns one if nobody is idle
+void wake_worker(tholder_pool_t *pool, const pthread_attr_t *attr);
+
+// Sets the pool that calls without a pool argument go to on this thread, see current_pool(), and returns
+// the previous one
+tholder_pool_t *swap_running_pool(tholder_pool_t *pool);
+
+// Same for the cancellation token tasks created on this thread inherit
+tholder_cancel_t *swap_running_cancel(tholder_cancel_t *cancel);
+
+// Starts a worker thread for `pool` in a free slot. Returns EAGAIN if `max_workers` are already alive
+int spawn_worker(tholder_pool_t *pool, const pthread_attr_t *attr);
+
+// Start and stop the controller thread of an elastic pool
+void elastic_start(tholder_pool_t *pool);
+void elastic_stop(tholder_pool_t *pool);
+
+// Stops the reactor threads of `pool`, if it has any. Tasks that register an fd after this wait until
+// reactor_destroy() frees them, once the workers are gone
+void reactor_stop(tholder_pool_t *pool);
+void reactor_destroy(tholder_pool_t *pool);
+
+// Same for the timer thread of `pool`. Timers armed after timer_stop() never fire
+void timer_stop(tholder_pool_t *pool);
+void timer_destroy(tholder_pool_t *pool);
+
+// Called by an idle worker of an elastic pool whose park timed out. Returns true if the pool has more
+// workers than its target, in which case the caller exits and is counted in `retiring_threads` until then
+bool elastic_retire(tholder_pool_t *pool);
+
+// Runs one task queued on `pool` on the calling thread, or one of its own pool's if it is a worker of
+// another pool. Returns false if there was nothing to run
+bool help_one_task(tholder_pool_t *pool);
+
+// Call before sleeping in a join. Returns false if work showed up on `pool`, in which case the caller should
+// help instead of sleeping. Otherwise a worker stops counting toward `max_active_workers` until blocking_end()
+bool blocking_begin(tholder_pool_t *pool);
+
+void blocking_end();
+
+// Counts the calling worker as blocked without looking for work first, for a task that may block anywhere in its
+// body, like a thread started through preload.c. Undone by blocking_end()
+void blocking_task_begin();
+
+// The worker in slot `index` of `pool`, or NULL if the slot is not filled in yet
+thread_data *pool_get(tholder_pool_t *pool, size_t index);
+
+// Monotonic clock in nanoseconds
+unsigned long long now_ns();
+
+// Adds to a counter that only the calling thread writes, without a locked instruction
+static inline void stat_add(atomic_ullong *counter, unsigned long long n)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// Prints the per-worker counters of `pool` to stderr, used on shutdown with the `dump_stats` option
+void stats_dump(tholder_pool_t *pool);
+
+// Called by a worker when a task spawned into `group` returns
+void group_task_done(tholder_group_t *group);
+
+#endif
@@ -0,0 +1,415 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "tholder.h"
+#include "tholder_internal.h"
+#include "futex.h"
+
+// Length of one tick. Delays are rounded up to whole ticks
+#define TIMER_TICK_NS 1000000ULL
+// Each level of the wheel has 2^TIMER_WHEEL_BITS slots, each slot of level `l` spans 64^l ticks. Four levels
+// reach about 4.6 hours ahead. A timer further out waits in the last level and is placed again when its
+// slot comes up
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+// Timers are allocated this many at a time, reused once they fire or are cancelled, and freed with the pool
+#define TIMER_CHUNK 256
+// Expired timers whose tasks are queued per turn of the lock
+#define TIMER_BATCH 64
+// How long the thread waits before it offers tasks the pool rejected again
+#define TIMER_RETRY_NS 1000000L
+
+#define TIMER_NEVER ~0ULL
+
+typedef struct timer_entry
+{
+    // Tick it is due at, and the ticks between runs of a periodic timer, 0 for a one-shot
+    unsigned long long expires;
+    unsigned long long period;
+    void *(*function)(void *);
+    void *args;
+    // Bumped whenever the entry is freed, so handles to the timer that had it before stop matching
+    uint32_t generation;
+    uint32_t index;
+    bool armed;
+    // Next entry in its slot of the wheel, or the next free entry, and the pointer that leads to this one,
+    // so it can be unlinked without knowing its slot
+    struct timer_entry *next;
+    struct timer_entry **pprev;
+} timer_entry;
+
+// The timers of one pool and the thread that fires them. Everything but `wake_seq` and `stop` is
+// guarded by `lock`
+struct timer_wheel
+{
+    tholder_pool_t *pool;
+    pthread_t thread;
+    pthread_mutex_t lock;
+
+    // now_ns() at tick 0, and the last tick whose timers were fired
+    unsigned long long base_ns;
+    unsigned long long current;
+    timer_entry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+
+    // Every entry by index, TIMER_CHUNK to a chunk, and the ones not in use
+    timer_entry **chunks;
+    size_t num_chunks;
+    timer_entry *free_entries;
+
+    // Tick the thread sleeps until. Arming a timer due earlier bumps `wake_seq` to wake it
+    unsigned long long next_wake;
+    atomic_uint wake_seq;
+    atomic_uint stop;
+};
+
+// A handle is the entry's generation and its index plus one, so that 0 is never valid
+static unsigned long long timer_id(const timer_entry *e)
+{
+    return ((unsigned long long)e->generation << 32) | ((unsigned long long)e->index + 1);
+}
+
+static timer_entry *timer_lookup(struct timer_wheel *w, unsigned long long id)
+{
+    size_t index = (size_t)(id & 0xffffffffULL) - 1;
+    if ((id & 0xffffffffULL) == 0 || index / TIMER_CHUNK >= w->num_chunks)
+        return NULL;
+    timer_entry *e = &w->chunks[index / TIMER_CHUNK][index % TIMER_CHUNK];
+    return e->generation == (uint32_t)(id >> 32) ? e : NULL;
+}
+
+static timer_entry *timer_alloc(struct timer_wheel *w)
+{
+    if (w->free_entries == NULL)
+    {
+        timer_entry **chunks = (timer_entry **)realloc(w->chunks, (w->num_chunks + 1) * sizeof(timer_entry *));
+        if (chunks == NULL)
+            return NULL;
+        w->chunks = chunks;
+        timer_entry *chunk = (timer_entry *)calloc(TIMER_CHUNK, sizeof(timer_entry));
+        if (chunk == NULL)
+            return NULL;
+        w->chunks[w->num_chunks] = chunk;
+        for (size_t i = TIMER_CHUNK; i-- > 0;)
+        {
+            chunk[i].index = (uint32_t)(w->num_chunks * TIMER_CHUNK + i);
+            chunk[i].next = w->free_entries;
+            w->free_entries = &chunk[i];
+        }
+        w->num_chunks++;
+    }
+
+    timer_entry *e = w->free_entries;
+    w->free_entries = e->next;
+    return e;
+}
+
+static void timer_free(struct timer_wheel *w, timer_entry *e)
+{
+    e->armed = false;
+    e->generation++;
+    e->next = w->free_entries;
+    w->free_entries = e;
+    atomic_fetch_sub(&w->pool->timers_pending, 1);
+}
+
+// Puts `e` in the slot for its `expires`, on the lowest level whose span reaches that far
+static void wheel_insert(struct timer_wheel *w, timer_entry *e)
+{
+    if (e->expires <= w->current)
+        e->expires = w->current + 1;
+
+    unsigned long long at = e->expires;
+    unsigned long long horizon = 1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+    if (at - w->current >= horizon)
+        at = w->current + horizon - 1;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && at - w->current >= 1ULL << (TIMER_WHEEL_BITS * (level + 1)))
+        level++;
+
+    timer_entry **slot = &w->slots[level][(at >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+    e->next = *slot;
+    if (e->next != NULL)
+        e->next->pprev = &e->next;
+    e->pprev = slot;
+    *slot = e;
+}
+
+static void wheel_remove(timer_entry *e)
+{
+    *e->pprev = e->next;
+    if (e->next != NULL)
+        e->next->pprev = e->pprev;
+}
+
+// Moves the timers of the higher-level slots that start at `current` down to where they belong now
+static void wheel_cascade(struct timer_wheel *w)
+{
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        if ((w->current & ((1ULL << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+            return;
+
+        timer_entry **slot = &w->slots[level][(w->current >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+        timer_entry *e = *slot;
+        *slot = NULL;
+        while (e != NULL)
+        {
+            timer_entry *next = e->next;
+            wheel_insert(w, e);
+            e = next;
+        }
+    }
+}
+
+// Takes the timers due up to tick `now` into `batch`. Returns how many, which is less than TIMER_BATCH
+// once the wheel has caught up
+static size_t wheel_expire(struct timer_wheel *w, unsigned long long now, task *batch)
+{
+    size_t count = 0;
+    while (true)
+    {
+        timer_entry **slot = &w->slots[0][w->current & (TIMER_WHEEL_SLOTS - 1)];
+        while (*slot != NULL && count < TIMER_BATCH)
+        {
+            timer_entry *e = *slot;
+            wheel_remove(e);
+
+            batch[count++] = (task){e->function, e->args, NULL, NULL};
+            // A periodic timer keeps its schedule. After a stall the wheel walks through the ticks it missed
+            // in one go, so the runs it fell behind on are skipped rather than fired back to back
+            if (e->period != 0)
+            {
+                e->expires += e->period;
+                if (e->expires <= now)
+                    e->expires += ((now - e->expires) / e->period + 1) * e->period;
+                wheel_insert(w, e);
+            }
+            else
+            {
+                timer_free(w, e);
+            }
+        }
+        if (count == TIMER_BATCH || w->current >= now)
+            return count;
+
+        w->current++;
+        wheel_cascade(w);
+    }
+}
+
+// The next tick with a timer due on the lowest level, or the next cascade, whichever is first
+static unsigned long long wheel_next_wake(struct timer_wheel *w)
+{
+    if (atomic_load(&w->pool->timers_pending) == 0)
+        return TIMER_NEVER;
+
+    unsigned long long tick = w->current + 1;
+    while (w->slots[0][tick & (TIMER_WHEEL_SLOTS - 1)] == NULL && (tick & (TIMER_WHEEL_SLOTS - 1)) != 0)
+        tick++;
+    return tick;
+}
+
+static unsigned long long tick_of(struct timer_wheel *w, unsigned long long ns)
+{
+    return ns <= w->base_ns ? 0 : (ns - w->base_ns) / TIMER_TICK_NS;
+}
+
+static void *timer_loop(void *args)
+{
+    struct timer_wheel *w = (struct timer_wheel *)args;
+    task batch[TIMER_BATCH];
+    // Tasks of `batch` the pool took so far, and how many it holds
+    size_t queued = 0;
+    size_t count = 0;
+
+    pthread_mutex_lock(&w->lock);
+    while (!atomic_load(&w->stop))
+    {
+        if (queued == count)
+        {
+            count = wheel_expire(w, tick_of(w, now_ns()), batch);
+            queued = 0;
+        }
+        if (queued < count)
+        {
+            // Queued without the lock, so a submission that blocks on a full queue cannot hold up
+            // tasks that arm timers
+            pthread_mutex_unlock(&w->lock);
+            while (queued < count && submit_task_to(w->pool, &batch[queued], NULL, -1, THOLDER_PRIORITY_NORMAL) == 0)
+            {
+                atomic_fetch_add(&w->pool->timers_fired, 1);
+                queued++;
+            }
+            // Rejected by a full queue. The rest of the batch is offered again, in order, once a worker
+            // may have made room
+            if (queued < count)
+                futex_wait(&w->wake_seq, atomic_load(&w->wake_seq), TIMER_RETRY_NS);
+            pthread_mutex_lock(&w->lock);
+            continue;
+        }
+
+        w->next_wake = wheel_next_wake(w);
+        unsigned int seq = atomic_load(&w->wake_seq);
+        long timeout_ns = -1;
+        if (w->next_wake != TIMER_NEVER)
+        {
+            unsigned long long wake_ns = w->base_ns + w->next_wake * TIMER_TICK_NS;
+            unsigned long long now = now_ns();
+            timeout_ns = wake_ns > now ? (long)(wake_ns - now) : 0;
+        }
+        pthread_mutex_unlock(&w->lock);
+        if (timeout_ns != 0)
+            futex_wait(&w->wake_seq, seq, timeout_ns);
+        pthread_mutex_lock(&w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// Starts the timer thread of `pool` unless it is running. Returns 0 or an errno value
+static int timer_start(tholder_pool_t *pool)
+{
+    int error = 0;
+    pthread_mutex_lock(&pool->lock);
+    if (atomic_load(&pool->timers_running))
+        goto out;
+    // A task that is drained during shutdown gets no new timer thread
+    if (atomic_load(&pool->shutting_down))
+    {
+        error = EAGAIN;
+        goto out;
+    }
+
+    struct timer_wheel *w = (struct timer_wheel *)calloc(1, sizeof(struct timer_wheel));
+    if (w == NULL)
+    {
+        error = ENOMEM;
+        goto out;
+    }
+    w->pool = pool;
+    pthread_mutex_init(&w->lock, NULL);
+    w->base_ns = now_ns();
+    w->next_wake = TIMER_NEVER;
+    if (real_pthread_create(&w->thread, NULL, timer_loop, w) != 0)
+        exit(EXIT_FAILURE);
+    pool->timers = w;
+    atomic_store(&pool->timers_running, true);
+
+out:
+    pthread_mutex_unlock(&pool->lock);
+    return error;
+}
+
+static int timer_arm(tholder_pool_t *pool, tholder_timer_t *timer, unsigned long long delay_ns,
+                     unsigned long long period_ns, void *(*fn)(void *), void *arg)
+{
+    if (!atomic_load(&pool->timers_running))
+    {
+        int error = timer_start(pool);
+        if (error != 0)
+            return error;
+    }
+
+    struct timer_wheel *w = pool->timers;
+    pthread_mutex_lock(&w->lock);
+    timer_entry *e = timer_alloc(w);
+    if (e == NULL)
+    {
+        pthread_mutex_unlock(&w->lock);
+        return ENOMEM;
+    }
+    // Rounded up, so a timer never fires early, and split so that no delay overflows
+    unsigned long long elapsed = now_ns() - w->base_ns;
+    e->expires = elapsed / TIMER_TICK_NS + delay_ns / TIMER_TICK_NS +
+                 (elapsed % TIMER_TICK_NS + delay_ns % TIMER_TICK_NS + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+    e->period = (period_ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+    e->function = fn;
+    e->args = arg;
+    e->armed = true;
+    atomic_fetch_add(&pool->timers_pending, 1);
+    wheel_insert(w, e);
+
+    if (timer != NULL)
+        *timer = (tholder_timer_t){pool, timer_id(e)};
+    // The thread sleeps past it, wake it up to sleep less
+    bool wake = e->expires < w->next_wake;
+    if (wake)
+        atomic_fetch_add(&w->wake_seq, 1);
+    pthread_mutex_unlock(&w->lock);
+
+    if (wake)
+        futex_wake(&w->wake_seq, 1);
+    return 0;
+}
+
+int tholder_pool_submit_after(tholder_pool_t *pool, tholder_timer_t *timer, unsigned long long delay_ns,
+                              void *(*fn)(void *), void *arg)
+{
+    return timer_arm(pool, timer, delay_ns, 0, fn, arg);
+}
+
+int tholder_pool_submit_every(tholder_pool_t *pool, tholder_timer_t *timer, unsigned long long period_ns,
+                              void *(*fn)(void *), void *arg)
+{
+    if (period_ns == 0)
+        return EINVAL;
+    return timer_arm(pool, timer, period_ns, period_ns, fn, arg);
+}
+
+int tholder_submit_after(tholder_timer_t *timer, unsigned long long delay_ns, void *(*fn)(void *), void *arg)
+{
+    return tholder_pool_submit_after(submit_pool(), timer, delay_ns, fn, arg);
+}
+
+int tholder_submit_every(tholder_timer_t *timer, unsigned long long period_ns, void *(*fn)(void *), void *arg)
+{
+    return tholder_pool_submit_every(submit_pool(), timer, period_ns, fn, arg);
+}
+
+bool tholder_timer_cancel(tholder_timer_t timer)
+{
+    if (timer.pool == NULL || !atomic_load(&timer.pool->timers_running))
+        return false;
+
+    struct timer_wheel *w = timer.pool->timers;
+    pthread_mutex_lock(&w->lock);
+    timer_entry *e = timer_lookup(w, timer.id);
+    bool cancelled = e != NULL && e->armed;
+    if (cancelled)
+    {
+        wheel_remove(e);
+        timer_free(w, e);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return cancelled;
+}
+
+void timer_stop(tholder_pool_t *pool)
+{
+    if (!atomic_load(&pool->timers_running))
+        return;
+
+    struct timer_wheel *w = pool->timers;
+    atomic_store(&w->stop, 1);
+    atomic_fetch_add(&w->wake_seq, 1);
+    futex_wake(&w->wake_seq, 1);
+    real_pthread_join(w->thread, NULL);
+}
+
+void timer_destroy(tholder_pool_t *pool)
+{
+    struct timer_wheel *w = pool->timers;
+    if (w == NULL)
+        return;
+
+    for (size_t i = 0; i < w->num_chunks; i++)
+        free(w->chunks[i]);
+    free(w->chunks);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+    pool->timers = NULL;
+    atomic_store(&pool->timers_pending, 0);
+    atomic_store(&pool->timers_running, false);
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "trace.h"
+#include "tholder_internal.h"
+
+typedef struct trace_event
+{
+    unsigned long long ts;
+    unsigned long long id;
+    void *(*fn)(void *);
+    trace_event_type type;
+} trace_event;
+
+// One track's events, a worker slot's or an outside thread's. Only the thread owning the track writes it
+typedef struct trace_buffer
+{
+    struct trace_buffer *next;
+    size_t tid;
+    // Worker slot of the thread, -1 for threads outside every pool, and the pool it belongs to
+    long worker;
+    size_t pool;
+    // Events recorded so far, the newest TRACE_BUFFER_EVENTS of them are kept
+    size_t count;
+    trace_event events[TRACE_BUFFER_EVENTS];
+} trace_buffer;
+
+atomic_bool tracing = false;
+
+static const char *trace_path = NULL;
+static unsigned long long trace_epoch = 0;
+static atomic_ullong next_task_id = 1;
+
+// Every buffer ever handed out, so trace_write() can find them
+static trace_buffer *buffers = NULL;
+static size_t num_buffers = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// The calling thread's buffer, and on a worker the slot that keeps it and what the track is named after
+static _Thread_local trace_buffer *local_buffer = NULL;
+static _Thread_local trace_buffer **local_slot = NULL;
+static _Thread_local size_t local_pool;
+static _Thread_local size_t local_worker;
+
+void trace_init(const char *path)
+{
+    // Buffers left from an earlier trace start over
+    pthread_mutex_lock(&trace_lock);
+    for (trace_buffer *buffer = buffers; buffer != NULL; buffer = buffer->next)
+        buffer->count = 0;
+    trace_path = path;
+    trace_epoch = now_ns();
+    pthread_mutex_unlock(&trace_lock);
+    atomic_store(&tracing, true);
+}
+
+unsigned long long trace_task_id()
+{
+    return atomic_fetch_add_explicit(&next_task_id, 1, memory_order_relaxed);
+}
+
+static trace_buffer *get_buffer()
+{
+    if (local_buffer != NULL)
+        return local_buffer;
+
+    trace_buffer *buffer = (trace_buffer *)malloc(sizeof(trace_buffer));
+    if (buffer == NULL)
+        exit(EXIT_FAILURE);
+    buffer->worker = local_slot != NULL ? (long)local_worker : -1;
+    buffer->pool = local_slot != NULL ? local_pool : 0;
+    buffer->count = 0;
+
+    pthread_mutex_lock(&trace_lock);
+    buffer->tid = num_buffers++;
+    buffer->next = buffers;
+    buffers = buffer;
+    pthread_mutex_unlock(&trace_lock);
+
+    if (local_slot != NULL)
+        *local_slot = buffer;
+    local_buffer = buffer;
+    return buffer;
+}
+
+void trace_record(trace_event_type type, unsigned long long id, void *(*fn)(void *))
+{
+    trace_buffer *buffer = get_buffer();
+    trace_event *event = &buffer->events[buffer->count % TRACE_BUFFER_EVENTS];
+    event->ts = now_ns();
+    event->id = id;
+    event->fn = fn;
+    event->type = type;
+    buffer->count++;
+}
+
+void trace_worker(size_t pool, size_t index, struct trace_buffer **slot)
+{
+    local_slot = slot;
+    local_pool = pool;
+    local_worker = index;
+    local_buffer = *slot;
+}
+
+// Chrome trace timestamps are in microseconds
+static double trace_us(unsigned long long ts)
+{
+    return (ts - trace_epoch) / 1000.0;
+}
+
+static void write_event(FILE *fp, const trace_buffer *buffer, const trace_event *event)
+{
+    double ts = trace_us(event->ts);
+    size_t tid = buffer->tid;
+
+    switch (event->type)
+    {
+    case TRACE_SUBMIT:
+        // An instant on the submitter, plus the start of an arrow to wherever the task runs
+        fprintf(fp, ",\n{\"name\":\"submit\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%zu,\"args\":{\"task\":%llu,\"fn\":\"%p\"}}",
+                ts, tid, event->id, (void *)(uintptr_t)event->fn);
+        fprintf(fp, ",\n{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"s\",\"id\":%llu,\"ts\":%.3f,\"pid\":1,\"tid\":%zu}",
+                event->id, ts, tid);
+        break;
+    case TRACE_START:
+        fprintf(fp, ",\n{\"name\":\"%p\",\"cat\":\"task\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%zu,\"args\":{\"task\":%llu}}",
+                (void *)(uintptr_t)event->fn, ts, tid, event->id);
+        fprintf(fp, ",\n{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%llu,\"ts\":%.3f,\"pid\":1,\"tid\":%zu}",
+                event->id, ts, tid);
+        break;
+    case TRACE_END:
+    case TRACE_JOIN_END:
+    case TRACE_GROUP_WAIT_END:
+        fprintf(fp, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%zu}", ts, tid);
+        break;
+    case TRACE_JOIN_BEGIN:
+        fprintf(fp, ",\n{\"name\":\"join\",\"cat\":\"wait\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%zu,\"args\":{\"task\":%llu}}",
+                ts, tid, event->id);
+        break;
+    case TRACE_GROUP_WAIT_BEGIN:
+        fprintf(fp, ",\n{\"name\":\"group wait\",\"cat\":\"wait\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%zu}", ts, tid);
+        break;
+    }
+}
+
+void trace_write()
+{
+    if (!atomic_exchange(&tracing, false))
+        return;
+
+    pthread_mutex_lock(&trace_lock);
+
+    FILE *fp = fopen(trace_path, "w");
+    if (fp == NULL)
+        perror("tholder: could not open trace file");
+    else
+    {
+        fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"tholder\"}}");
+
+        for (trace_buffer *buffer = buffers; buffer != NULL; buffer = buffer->next)
+        {
+            if (buffer->worker >= 0 && buffer->pool != 0)
+                fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"pool %zu worker %ld\"}}",
+                        buffer->tid, buffer->pool, buffer->worker);
+            else if (buffer->worker >= 0)
+                fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"worker %ld\"}}",
+                        buffer->tid, buffer->worker);
+            else
+                fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"thread %zu\"}}",
+                        buffer->tid, buffer->tid);
+
+            // Oldest kept event first
+            size_t first = buffer->count > TRACE_BUFFER_EVENTS ? buffer->count - TRACE_BUFFER_EVENTS : 0;
+            for (size_t i = first; i < buffer->count; i++)
+                write_event(fp, buffer, &buffer->events[i % TRACE_BUFFER_EVENTS]);
+        }
+
+        fprintf(fp, "\n]}\n");
+        fclose(fp);
+    }
+
+    // Not freed: workers of other pools may still be recording an event they began before tracing stopped,
+    // and worker slots keep pointing at theirs. There is one per slot and outside thread, and it is reused
+    pthread_mutex_unlock(&trace_lock);
+}
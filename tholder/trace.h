@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Events kept per thread. Once a buffer is full the oldest events are overwritten
+#define TRACE_BUFFER_EVENTS 16384
+
+// A track's ring of events, see trace.c
+struct trace_buffer;
+
+typedef enum trace_event_type
+{
+    TRACE_SUBMIT,
+    TRACE_START,
+    TRACE_END,
+    TRACE_JOIN_BEGIN,
+    TRACE_JOIN_END,
+    TRACE_GROUP_WAIT_BEGIN,
+    TRACE_GROUP_WAIT_END
+} trace_event_type;
+
+// Set by trace_init(). Every hook checks it first, so tracing costs one branch when it is off
+extern atomic_bool tracing;
+
+// Starts recording events, to be written to `path` by trace_write()
+void trace_init(const char *path);
+
+// A new id linking the submit, start, end and join events of one task
+unsigned long long trace_task_id();
+
+// Appends an event to the calling thread's ring buffer. `fn` is the task function, or NULL
+void trace_record(trace_event_type type, unsigned long long id, void *(*fn)(void *));
+
+// Makes the calling thread record into `*slot`, the ring of worker slot `index` of pool `pool` (0 for the
+// default pool), named after it. The ring is allocated on the first event and then reused by every worker
+// that takes the slot
+void trace_worker(size_t pool, size_t index, struct trace_buffer **slot);
+
+// Stops tracing and writes every buffer as Chrome trace JSON. The buffers are kept for the next trace_init()
+void trace_write();
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+
+#include "work_deque.h"
+
+work_deque *work_deque_init(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    work_deque *dq = (work_deque *)aligned_alloc(CACHE_LINE_SIZE, sizeof(work_deque));
+    if (dq == NULL)
+        exit(EXIT_FAILURE);
+
+    dq->buffer = (task *)calloc(size, sizeof(task));
+    if (dq->buffer == NULL)
+        exit(EXIT_FAILURE);
+
+    dq->mask = (long)size - 1;
+    atomic_init(&dq->top, 0);
+    atomic_init(&dq->bottom, 0);
+    return dq;
+}
+
+void work_deque_destroy(work_deque *dq)
+{
+    if (dq == NULL)
+        return;
+
+    free(dq->buffer);
+    free(dq);
+}
+
+bool work_deque_push(work_deque *dq, const task *t)
+{
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    long t_idx = atomic_load_explicit(&dq->top, memory_order_acquire);
+
+    // A stale `top` only makes us more conservative, so a slot that a thief
+    // may still be reading is never overwritten
+    if (b - t_idx > dq->mask)
+        return false;
+
+    dq->buffer[b & dq->mask] = *t;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+bool work_deque_take(work_deque *dq, task *t)
+{
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t_idx = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+    if (t_idx > b)
+    {
+        // Empty, restore bottom
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        return false;
+    }
+
+    *t = dq->buffer[b & dq->mask];
+    if (t_idx == b)
+    {
+        // Last element, race the thieves for it
+        bool won = atomic_compare_exchange_strong_explicit(&dq->top, &t_idx, t_idx + 1,
+                                                           memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+
+    return true;
+}
+
+steal_result work_deque_steal(work_deque *dq, task *t)
+{
+    long t_idx = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    if (t_idx >= b)
+        return STEAL_EMPTY;
+
+    task stolen = dq->buffer[t_idx & dq->mask];
+    if (!atomic_compare_exchange_strong_explicit(&dq->top, &t_idx, t_idx + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed))
+        return STEAL_ABORT;
+
+    *t = stolen;
+    return STEAL_SUCCESS;
+}
+
+bool work_deque_empty(work_deque *dq)
+{
+    long b = atomic_load(&dq->bottom);
+    long t_idx = atomic_load(&dq->top);
+    return t_idx >= b;
+}
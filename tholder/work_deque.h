@@ -0,0 +1,43 @@
+#ifndef WORK_DEQUE_H
+#define WORK_DEQUE_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "task_queue.h"
+
+// Result of a steal attempt. ABORT means we lost a race and the victim may still have work
+typedef enum steal_result
+{
+    STEAL_EMPTY,
+    STEAL_SUCCESS,
+    STEAL_ABORT
+} steal_result;
+
+// Chase-Lev work-stealing deque with a fixed capacity.
+// Only the owning worker may push and take (at the bottom). Any thread may steal (at the top).
+typedef struct work_deque
+{
+    _Alignas(CACHE_LINE_SIZE) atomic_long top;
+    _Alignas(CACHE_LINE_SIZE) atomic_long bottom;
+    task *buffer;
+    long mask;
+} work_deque;
+
+// `capacity` is rounded up to the next power of two
+work_deque *work_deque_init(size_t capacity);
+
+void work_deque_destroy(work_deque *dq);
+
+// Owner only. Returns false if the deque is full
+bool work_deque_push(work_deque *dq, const task *t);
+
+// Owner only. Pops the most recently pushed task
+bool work_deque_take(work_deque *dq, task *t);
+
+// Any thread. Removes the oldest task
+steal_result work_deque_steal(work_deque *dq, task *t);
+
+bool work_deque_empty(work_deque *dq);
+
+#endif